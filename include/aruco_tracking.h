@@ -39,10 +39,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sensor_msgs/image_encodings.h>
 #include <camera_calibration_parsers/parse_ini.h>
 #include <tf/transform_broadcaster.h>
-#include <tf/transform_listener.h>
 #include <visualization_msgs/Marker.h>
+#include <visualization_msgs/MarkerArray.h>
 #include <image_transport/image_transport.h>
 #include <cv_bridge/cv_bridge.h>
+#include <std_srvs/Empty.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+// Standard libraries
+#include <algorithm>
+#include <bitset>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include <boost/function.hpp>
 
 // Aruco libraries
 #include <aruco/aruco.h>
@@ -54,10 +68,23 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/video/tracking.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
 // Custom message
 #include <aruco_tracking/ArucoMarker.h>
+#include <aruco_tracking/DetectorSettings.h>
+
+// Package libraries
+#include <spsc_queue.h>
+#include <marker_map_file.h>
+#include <pose_graph.h>
+#include <marker_store.h>
+#include <tracker_metrics.h>
+#include <luma_extraction.h>
+#include <marker_front_end.h>
+#include <frame_budget_governor.h>
+#include <frame_trace.h>
 
 /** \brief Aruco mapping namespace */
 namespace aruco_tracking
@@ -68,66 +95,299 @@ class ArucoTracking
 {
 public:
 
-  /** \brief Struct to keep marker information */
-  struct MarkerInfo
+  /** \brief Time spent by one frame in every stage, in seconds */
+  struct FrameTiming
   {
+    double convert = 0;                             // Image conversion and ROI
+    double detect = 0;                              // Marker detection including per-marker extrinsics
+    double map = 0;                                 // Marker map update, chaining and pose graph
+    double pose = 0;                                // Camera pose and output preparation
+    double publish = 0;                             // TFs, custom message and images
+  };
+
+  /** \brief Called with header of received image, stage timing and custom message of every published frame */
+  typedef boost::function<void (int camera_index, const std_msgs::Header &header, const FrameTiming &timing,
+                                const aruco_tracking::ArucoMarkerConstPtr &marker_msg)> FrameTimingCallback;
+
+  /** \brief Struct to keep marker tracked in image by dynamic ROI */
+  struct TrackedMarker
+  {
+    int marker_id;                                  // Marker ID
+    cv::Point2f center;                             // Center of marker in image
+    cv::Point2f velocity;                           // Motion of center since previous frame in px
+    cv::Rect bounding_box;                          // Bounding box of marker corners
+  };
 
-    bool visible = false;                                   // Marker visibile in actual image?
-    int marker_id = -1;                                  // Marker ID
-    int previous_marker_id = -1;                         // Used for chaining markers
-    geometry_msgs::Pose geometry_msg_to_previous;   // Position with respect to previous marker
-    tf::StampedTransform tf_to_previous;            // TF with respect to previous marker
-    geometry_msgs::Pose geometry_msg_to_world;      // Position with respect to world's origin
-    tf::StampedTransform tf_to_world;               // TF with respect to world's origin
-    geometry_msgs::Pose current_camera_pose;        // Position of camera with respect to the marker
-    tf::Transform current_camera_tf;                // TF of camera with respect to the marker
+  /** \brief Struct to keep one image while it passes convert, detect, pose and publish stages */
+  struct Frame
+  {
+    bool dropped = false;                           // Frame skipped by detect stage in favour of a newer one
+    uint32_t sequence = 0;                          // Frame number of camera, groups trace spans of one frame
+    std::chrono::steady_clock::time_point received; // Arrival in image callback
+    FrameTiming timing;                             // Time spent in stages
+    std_msgs::Header header;                        // Header of received image, stamp of every output
+    cv_bridge::CvImageConstPtr cv_ptr;              // Keeps received image alive
+    cv::Mat image;                                  // ROI of received image, read-only view
+    cv::Mat luma;                                   // Reused buffer of ROI luminance of color images
+    std::vector<aruco::Marker> markers;             // Markers detected in image
+    bool publish_tfs = false;                       // Any TF known to be published
+    std::vector<tf::StampedTransform> transforms;   // TFs of the frame, sent in one call
+    tf::StampedTransform world_position_transform;  // TF of camera with respect to world's origin
+    aruco_tracking::ArucoMarkerPtr marker_msg;      // Custom message to be published
+  };
+
+  /** \brief Struct to keep state of one camera, all cameras share one marker map */
+  struct CameraContext
+  {
+    int index;                                      // Index in cameras_
+    uint32_t next_sequence;                         // Number of next received frame
+    std::string name;                               // Camera name, namespace of its topics, empty for single camera
+    std::string image_topic;                        // Subscribed image topic
+    std::string calib_filename;                     // Calibration filepath
+    std::string window_name;                        // OpenCV window name
+    std::string camera_frame;                       // TF frame of camera with respect to world
+    std::string rig_frame;                          // TF frame of rig as estimated by this camera
+    tf::Transform extrinsics;                       // Camera pose with respect to rig
+    aruco::CameraParameters calib_params;           // Calibration for aruco detection
+    aruco::CameraParameters pose_params;            // Calibration of undistorted corners, no distortion if map is used
+    cv::Mat undistort_map;                          // Undistorted position of every pixel, empty if no distortion
+    aruco::MarkerDetector detector;                 // Detector, kept alive so its buffers are reused
+    MarkerFrontEnd front_end;                       // Thresholding and quads in the package, identification by aruco
+    bool front_end_enabled;                         // Front end replaces detector for whole image detection
+    std::vector<aruco::Marker> verify_markers;      // Markers found by detector when front end is verified
+    double front_end_seconds;                       // Verification - time spent in front end
+    double detector_seconds;                        // Verification - time spent in detector
+    int verified_frames;                            // Verification - frames detected by both
+    int mismatched_frames;                          // Verification - frames with different results
+    FrameBudgetGovernor governor;                   // Frame time controller, updated by publish stage
+    std::atomic<int> governor_level;                // Level chosen by publish stage for detect stage
+    int applied_governor_level;                     // Level the detector is set to
+    DetectorTuning tuning;                          // Settings of detect stage
+    ros::Publisher detector_settings_pub;           // Publisher of aruco_tracking::DetectorSettings message
+    cv::Size tiles_image_size;                      // Image size tiles were computed for
+    std::vector<cv::Rect> tiles;                    // Overlapping tiles of tiled detection
+    std::vector<aruco::MarkerDetector> region_detectors;        // Detector of every tile or search window
+    std::vector<std::vector<aruco::Marker> > region_markers;    // Markers found in every tile or search window
+    std::vector<TrackedMarker> tracked_markers;                 // Markers tracked by dynamic ROI
+    std::vector<TrackedMarker> previous_tracked_markers;        // Tracked markers of previous frame
+    std::vector<cv::Rect> search_windows;                       // Predicted search windows
+    int frames_since_full_scan;                                 // Frames detected in search windows only
+    std::vector<cv::Mat> pyramid;                               // Downscaled images of coarse-to-fine detection
+    int frames_since_detection;                                 // Frames tracked by optical flow only
+    std::vector<aruco::Marker> flow_markers;                    // Markers of previous frame, corners tracked by optical flow
+    std::vector<cv::Mat> flow_pyramid;                          // Optical flow pyramid of current frame
+    std::vector<cv::Mat> flow_previous_pyramid;                 // Optical flow pyramid of previous frame
+    std::vector<cv::Point2f> flow_previous_points;              // Corners in previous frame
+    std::vector<cv::Point2f> flow_points;                       // Corners tracked to current frame
+    std::vector<cv::Point2f> flow_back_points;                  // Corners tracked back for quality check
+    std::vector<uchar> flow_status;
+    std::vector<uchar> flow_back_status;
+    std::vector<float> flow_error;
+    int closest_camera_index;                       // Visible marker closest to the camera
+    std::vector<CompactPose> marker_camera_poses;   // Pose of this camera with respect to every marker in the last frame it was seen
+    std::vector<uint8_t> marker_camera_known;       // Marker seen by this camera, its pose above is valid
+    std::vector<std::string> marker_camera_frames;  // TF frame of this camera above every marker, built once
+    tf::StampedTransform world_position_transform;  // Actual TF of camera with respect to world's origin
+    ros::Time last_tf_publish;                      // Last time TFs of this camera were sent
+    geometry_msgs::Pose world_position_geometry_msg;// Actual Pose of camera with respect to world's origin
+    cv::Mat output_image;                           // Writable copy of the ROI for drawing
+    image_transport::Subscriber image_sub;          // Image subscriber
+    ros::Publisher marker_msg_pub;                  // Publisher of aruco_tracking::ArucoMarker custom message
+    image_transport::Publisher debug_image_pub;     // Publisher of overlay image to "debug_image" topic
+    std::vector<aruco_tracking::ArucoMarkerPtr> marker_msg_pool;  // Reused outgoing messages
+    size_t marker_msg_pool_slot;                    // Next pool slot to replace
+    std::vector<Frame> frames;                      // Frames in flight, serial mode uses the first one
+    boost::shared_ptr<SpscQueue<Frame *> > free_frames;    // Frames ready for convert stage
+    boost::shared_ptr<SpscQueue<Frame *> > detect_queue;   // Convert -> detect
+    boost::shared_ptr<SpscQueue<Frame *> > pose_queue;     // Detect -> pose
+    boost::shared_ptr<SpscQueue<Frame *> > publish_queue;  // Pose -> publish
+    std::thread detect_thread;
+    std::thread pose_thread;
+    std::thread publish_thread;
   };
 
 public:
 
   /** \brief Construct a client for EZN64 USB control*/
-  ArucoTracking(ros::NodeHandle *nh);
+  ArucoTracking(ros::NodeHandle *nh, ros::NodeHandle *private_nh);
 
   ~ArucoTracking();
 
-  /** \brief Callback function to handle image processing*/
-  void imageCallback(const sensor_msgs::ImageConstPtr &original_image);
+  /** \brief Callback function to handle image processing of one camera*/
+  void imageCallback(const sensor_msgs::ImageConstPtr &original_image, int camera_index);
+
+  /** \brief Stage timing and result of every published frame are handed to callback, used by the benchmark*/
+  void setFrameTimingCallback(const FrameTimingCallback &callback);
 
 private:
 
-  /** \brief Function to parse data from calibration file*/
-  bool parseCalibrationFile(std::string filename);
+  /** \brief Function to parse list of cameras with their calibrations and extrinsics*/
+  bool parseCameras(XmlRpc::XmlRpcValue &cameras_param);
+
+  /** \brief Function to parse list of allowed marker IDs with their sizes*/
+  bool parseMarkers(XmlRpc::XmlRpcValue &markers_param);
+
+  /** \brief Drop markers with IDs not allowed, before pose estimation*/
+  void rejectMarkers(std::vector<aruco::Marker> &markers);
+
+  /** \brief Topic name in camera namespace*/
+  std::string cameraTopic(const CameraContext &camera, const std::string &topic);
+
+  /** \brief Function to parse data from calibration file and build undistortion map of calibrated resolution*/
+  bool parseCalibrationFile(std::string filename, aruco::CameraParameters &calib_params, cv::Mat &undistort_map);
+
+  /** \brief Fills marker map from map file, world's origin known before first image*/
+  bool loadMap(const std::string &filename);
 
-  /** \brief Function to publish all known TFs*/
-  void publishTfs(bool world_option);
+  /** \brief Writes all markers chained to world into map file*/
+  bool saveMap(const std::string &filename);
 
-  /** \brief Function to publish all known markers for visualization purposes*/
-  void publishMarker(geometry_msgs::Pose markerPose, int MarkerID);
+  /** \brief Service callback saving the map on request*/
+  bool saveMapCallback(std_srvs::Empty::Request &request, std_srvs::Empty::Response &response);
 
-  /** \brief Publisher of visualization_msgs::Marker message to "aruco_markers" topic*/
+  /** \brief Function to collect all known TFs into the frame, sent at once by the publish stage*/
+  void collectTfs(CameraContext &camera, Frame &frame, bool world_option);
+
+  /** \brief Timer callback publishing markers seen recently for visualization purposes*/
+  void visualizationTimerCallback(const ros::TimerEvent &event);
+
+  /** \brief Fill cube of one marker in world's frame*/
+  void fillVisMarker(visualization_msgs::Marker &vis_marker, int marker_id, const ros::Time &stamp);
+
+  /** \brief Timer callback publishing frame loop metrics on "/diagnostics" and into metrics file*/
+  void metricsTimerCallback(const ros::TimerEvent &event);
+
+  /** \brief Publisher of visualization_msgs::MarkerArray message to "aruco_markers" topic*/
   ros::Publisher marker_visualization_pub_;
 
-  /** \brief Publisher of aruco_mapping::ArucoMarker custom message*/
-  ros::Publisher marker_msg_pub_;
+  /** \brief Timer of visualization, runs apart from the frame loop*/
+  ros::Timer visualization_timer_;
 
   ros::Publisher marker_raw_;
 
+  /** \brief Service "save_map" writing the marker map to map file*/
+  ros::ServiceServer save_map_service_;
+
+  /** \brief Service "dump_trace" writing spans of recent frames to trace file*/
+  bool dumpTraceCallback(std_srvs::Empty::Request &request, std_srvs::Empty::Response &response);
+
+  /** \brief Timer callback dumping trace when dump signal was received since last call*/
+  void traceTimerCallback(const ros::TimerEvent &event);
+
+  /** \brief Writes spans of all threads into trace file in Chrome trace format*/
+  bool dumpTrace();
+
+  /** \brief Add span from start till now to trace, if tracing*/
+  void traceSpan(FrameTrace::Span span, const CameraContext &camera, const Frame &frame,
+                 const std::chrono::steady_clock::time_point &start, int marker_id = -1);
+
+  ros::ServiceServer dump_trace_service_;
+  ros::Timer trace_timer_;
+
+  /** \brief Publisher of diagnostic_msgs::DiagnosticArray message to "/diagnostics" topic*/
+  ros::Publisher diagnostics_pub_;
+
+  /** \brief Timer of metrics export*/
+  ros::Timer metrics_timer_;
+
   /** \brief Compute TF from marker detector result*/
   tf::Transform arucoMarker2Tf(const aruco::Marker &marker);
 
-  /** \brief Process actual image, detect markers and compute poses */
-  bool processImage(cv::Mat input_image,cv::Mat output_image);
+  /** \brief Convert stage, take image and cut ROI without copy */
+  bool convertImage(CameraContext &camera, const sensor_msgs::ImageConstPtr &original_image, Frame &frame);
+
+  /** \brief Detect stage, find markers in image */
+  void detectMarkers(CameraContext &camera, Frame &frame);
+
+  /** \brief Detect markers in whole image, in tiles if enabled */
+  void detectMarkersFullFrame(CameraContext &camera, Frame &frame);
+
+  /** \brief Detect markers in image regions in parallel and merge duplicates at region borders */
+  void detectMarkersInRegions(CameraContext &camera, Frame &frame, const std::vector<cv::Rect> &regions);
+
+  /** \brief Undistort corners of detected markers by map lookup and solve their poses */
+  void computeMarkerPoses(CameraContext &camera, Frame &frame);
+
+  /** \brief Set detector of camera to settings of governor level, called by detect stage */
+  void applyDetectorTuning(CameraContext &camera, int level);
+
+  /** \brief Publish settings of current governor level to "detector_settings" topic */
+  void publishDetectorSettings(CameraContext &camera, const ros::Time &stamp);
+
+  /** \brief Markers of one image without poses, by front end or by aruco detector */
+  void detectCandidates(CameraContext &camera, const cv::Mat &image, std::vector<aruco::Marker> &markers);
+
+  /** \brief Pyramid level for detection, chosen from expected marker size if negative */
+  int pyramidLevel();
+
+  /** \brief Detect markers in downscaled image and refine their corners in full resolution */
+  void detectMarkersPyramid(CameraContext &camera, Frame &frame, int pyramid_level);
+
+  /** \brief Track corners of markers of previous frame by pyramidal Lucas-Kanade, false if tracking quality is poor */
+  bool trackMarkersOpticalFlow(CameraContext &camera, Frame &frame);
+
+  /** \brief Split image into overlapping tiles */
+  void computeTiles(CameraContext &camera, const cv::Size &image_size);
+
+  /** \brief Predict search windows from tracked marker positions and motion */
+  void predictSearchWindows(CameraContext &camera, const cv::Size &image_size);
+
+  /** \brief Check if any tracked marker was not found */
+  bool trackingLost(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers);
+
+  /** \brief Remember positions and motion of markers for next frame */
+  void updateTrackedMarkers(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers);
+
+  /** \brief Pose stage, update marker map and compute poses of detected markers */
+  bool processImage(CameraContext &camera, Frame &frame);
+
+  /** \brief Publish stage, send TFs, custom message and images */
+  void publishFrame(CameraContext &camera, Frame &frame);
+
+  /** \brief Stage threads of pipeline mode, linked by bounded lock-free queues */
+  void detectThread(CameraContext *camera);
+  void poseThread(CameraContext *camera);
+  void publishThread(CameraContext *camera);
+
+  /** \brief Draw marker convex, ID, cube and axis into image */
+  void drawMarkers(cv::Mat &image, std::vector<aruco::Marker> &markers, const aruco::CameraParameters &calib_params);
+
+  /** \brief Pass image and detected markers to the debug image thread, never blocks */
+  void queueDebugImage(CameraContext &camera, Frame &frame);
+
+  /** \brief Low priority thread rendering overlay and publishing it to "debug_image" topic */
+  void debugImageThread();
   bool isDetected(int marker_id);
   void detectFirstMarker(std::vector<aruco::Marker> &real_time_markers);
   void markVisible(std::vector<aruco::Marker> &real_time_markers);
-  void setCurrentCameraPose(aruco::Marker &real_time_marker, int index, bool inverse);
-  void publishCustomMarker(bool any_markers_visible, int num_of_visible_markers);
-  void computeGlobalCameraPose(bool any_markers_visible);
+  void setCurrentCameraPose(CameraContext &camera, aruco::Marker &real_time_marker, int index, bool inverse);
+  void prepareCustomMarker(CameraContext &camera, Frame &frame, bool any_markers_visible, int num_of_visible_markers);
+
+  /** \brief Get message from pool which is not held by any subscriber */
+  aruco_tracking::ArucoMarkerPtr acquireMarkerMsg(CameraContext &camera);
+
+  /** \brief Message with vectors reserved for all markers */
+  aruco_tracking::ArucoMarkerPtr newMarkerMsg();
+  void computeGlobalCameraPose(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers,
+                               bool any_markers_visible, int num_of_visible_markers, const ros::Time &stamp);
+
+  /** \brief One PnP over corners of all visible mapped markers, camera_to_world holds initial guess on input*/
+  bool solveCameraPoseJoint(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers,
+                            tf::Transform &camera_to_world);
   void computeGlobalMarkerPose(int index);
-  void nearestMarkersToCamera(bool &any_markers_visible, int &num_of_visible_markers);
+  void nearestMarkersToCamera(CameraContext &camera, bool &any_markers_visible, int &num_of_visible_markers);
   void knownMarkerInImage(bool &any_known_marker_visible, int &last_marker_id, int index);
-  void publishCameraMarkerTransforms(int index, int last_marker_id);
-  void setCameraPose(int index, bool inverse);
+  void computeMarkerToPrevious(CameraContext &camera, int index, int last_marker_id);
+
+  /** \brief Compose TF of marker with respect to world's origin by walking the marker chain*/
+  bool computeMarkerToWorld(int marker_id, tf::Transform &marker_to_world);
+
+  /** \brief Adds relative poses of markers seen together to pose graph and takes world poses from it*/
+  void updatePoseGraph(CameraContext &camera, std::vector<aruco::Marker> &real_time_markers);
+
+  /** \brief Pose with respect to previous marker from world poses of both*/
+  void updateToPrevious(int marker_id);
+  void setCameraPose(CameraContext &camera, int index, const tf::Transform &marker_to_camera, bool inverse);
   //Launch file params
   std::string calib_filename_;
   std::string space_type_;
@@ -138,35 +398,144 @@ private:
   int  roi_y_;
   int  roi_w_;
   int  roi_h_;
+  int  tiles_x_;
+  int  tiles_y_;
+  int  tile_overlap_;
+  bool dynamic_roi_;
+  double dynamic_roi_margin_;
+  int  dynamic_roi_full_scan_period_;
+  int  detection_period_;
+  int  pyramid_level_;
+  double expected_marker_pixels_;
+  std::string map_file_;
+  bool save_map_on_exit_;
+  bool joint_pnp_;
+  double tf_publish_rate_;
+  double visualization_rate_;
+  double metrics_rate_;
+  bool fast_front_end_;
+  bool fast_front_end_verify_;
+  double frame_budget_ms_;
+  std::string metrics_file_;
+  int trace_buffer_size_;
+  std::string trace_file_;
+  bool trace_dump_signal_;
+
+  /** \brief Private node handle for parameters changed at runtime */
+  ros::NodeHandle private_nh_;
+  bool headless_;
+  bool multi_camera_;
+  bool pipeline_enabled_;
+  bool pipeline_block_;
+  int pipeline_queue_size_;
+
+  /** \brief Receiver of stage timing, empty if nobody measures */
+  FrameTimingCallback frame_timing_callback_;
+
+  /** \brief Counters and stage latencies, updated by every thread of the frame loop */
+  TrackerMetrics metrics_;
+
+  /** \brief Metrics at previous export, rates and latencies are reported per export period */
+  TrackerMetrics::Snapshot metrics_previous_;
+  std::chrono::steady_clock::time_point metrics_previous_time_;
+
+  /** \brief Spans of recent frames, disabled unless trace_buffer_size is set */
+  FrameTrace trace_;
+
+  /** \brief Dump signals handled so far */
+  int trace_dump_requests_;
+
+  /** \brief Cleared to stop pipeline threads */
+  std::atomic<bool> pipeline_running_;
+
+  /** \brief IDs accepted after decoding, all by default */
+  std::bitset<MarkerStore::CAPACITY> allowed_ids_;
+
+  /** \brief Side of every marker in m, marker_size_ unless set by markers parameter */
+  std::vector<float> marker_sizes_;
+
+  /** \brief Cameras sharing the marker map */
+  std::vector<boost::shared_ptr<CameraContext> > cameras_;
+
+  /** \brief All detected markers indexed by ID */
+  MarkerStore markers_;
+
+  /** \brief TF frame names of every marker ID, built once */
+  std::vector<std::string> marker_frame_names_;
+  std::vector<std::string> marker_globe_frame_names_;
+
+  /** \brief Guards the marker map and everything computed from it, detection runs outside */
+  std::mutex map_mutex_;
+
+  /** \brief Guards HighGUI calls of different cameras */
+  std::mutex gui_mutex_;
+
+  /** \brief Reused outgoing visualization message */
+  visualization_msgs::MarkerArray vis_markers_;
+
+  /** \brief Markers currently shown in RViz, deleted there once not seen anymore */
+  std::vector<int> vis_shown_ids_;
+
+  /** \brief Debug image rendering thread and data handed over to it */
+  std::thread debug_thread_;
+  std::mutex debug_mutex_;
+  std::condition_variable debug_condition_;
+  bool debug_running_;
+  bool debug_pending_;
+  CameraContext *debug_camera_;
+  std_msgs::Header debug_header_;
+  cv::Mat debug_gray_;
+  cv::Mat debug_color_;
+  std::vector<aruco::Marker> debug_markers_;
+
+  /** \brief Scratch matrices of arucoMarker2Tf */
+  cv::Mat rotate_to_ros_;
+  cv::Mat marker_rotation_;
+  cv::Mat marker_rotation_ros_;
 
-  /** \brief Container holding MarkerInfo data about all detected markers */
-   std::map<int, MarkerInfo> markers_;
-
-  /** \brief Actual TF of camera with respect to world's origin */
-  tf::StampedTransform world_position_transform_;
-
-  /** \brief Actual Pose of camera with respect to world's origin */
-  geometry_msgs::Pose world_position_geometry_msg_;
-
-  aruco::CameraParameters aruco_calib_params_;
-
-  int closest_camera_index_;
   int lowest_marker_id_;
   bool first_marker_detected_;
 
-  tf::TransformListener *listener_;
+  /** \brief Optimized world poses of chained markers */
+  PoseGraph pose_graph_;
+  std::vector<int> pose_graph_touched_;
+  std::vector<int> pose_graph_updated_;
+
+  /** \brief Scratch data of joint PnP, reused every frame */
+  std::vector<cv::Point3f> joint_object_points_;
+  std::vector<cv::Point2f> joint_image_points_;
+  cv::Mat joint_rvec_;
+  cv::Mat joint_tvec_;
+  cv::Mat joint_rotation_;
+
   tf::TransformBroadcaster broadcaster_;
 
   //Consts
    static const int CV_WAIT_KEY = 10;
    static const int CV_WINDOW_MARKER_LINE_WIDTH = 2;
+   static const int MARKER_MSG_POOL_SIZE = 4;
+   static const int PIPELINE_NUM_OF_STAGES = 4;
+   static const int PYRAMID_MAX_LEVEL = 3;
+   static const int PYRAMID_REFINE_ITERATIONS = 12;
+   static const int FLOW_WINDOW_SIZE = 21;
+   static const int FLOW_PYRAMID_LEVELS = 3;
+   static const int POSE_GRAPH_HOPS = 2;
+   static const int POSE_GRAPH_MAX_NODES = 64;
+   static const int POSE_GRAPH_ITERATIONS = 4;
+   static const int TRACE_DUMP_SIGNAL = SIGUSR1;
+
+   static constexpr double PYRAMID_MIN_MARKER_PIXELS = 40;
+   static constexpr double PYRAMID_REFINE_EPSILON = 0.005;
+   static constexpr double FLOW_MAX_BACK_ERROR = 1.0;
+   static constexpr double FLOW_MIN_AREA_RATIO = 0.7;
+   static constexpr double FRONT_END_VERIFY_TOLERANCE = 0.001;
+   static constexpr double TRACE_POLL_PERIOD = 0.2;
+   static constexpr double TRACE_MAX_RECEIVE_AGE = 10.0;
 
-   static constexpr double WAIT_FOR_TRANSFORM_INTERVAL = 2.0;
-   static constexpr double BROADCAST_WAIT_INTERVAL = 0.0001;
    static constexpr double INIT_MIN_SIZE_VALUE = 1000000;
 
    static constexpr double RVIZ_MARKER_HEIGHT = 0.01;
-   static constexpr double RVIZ_MARKER_LIFETIME = 0.2;
+   static constexpr double RVIZ_MARKER_TIMEOUT = 1.0;
    static constexpr double RVIZ_MARKER_COLOR_R = 1.0;
    static constexpr double RVIZ_MARKER_COLOR_G = 1.0;
    static constexpr double RVIZ_MARKER_COLOR_B = 1.0;
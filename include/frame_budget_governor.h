@@ -0,0 +1,109 @@
+/*********************************************************************************************//**
+* @file frame_budget_governor.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef FRAME_BUDGET_GOVERNOR_H
+#define FRAME_BUDGET_GOVERNOR_H
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Costly detector settings, changed at runtime to hold the frame budget */
+struct DetectorTuning
+{
+  int pyramid_level_offset = 0;                   // Levels added to configured pyramid level
+  int threshold_block_size = 7;                   // Adaptive threshold window in px of full resolution
+  double threshold_constant = 7;                  // Adaptive threshold constant
+  float min_marker_size = 0.04;                   // Contour length limits relative to image size
+  float max_marker_size = 0.5;
+  double roi_margin = 0.5;                        // Search window growth relative to marker size
+  int full_scan_period = 15;                      // Frames between whole image scans of dynamic ROI
+};
+
+/** \brief Controller keeping smoothed frame time under budget by stepping through levels of cheaper
+ *         detector settings. Level 0 is the configured settings, a level is held for HOLD_FRAMES frames
+ *         before the next step so that the smoothed time settles */
+class FrameBudgetGovernor
+{
+public:
+
+  FrameBudgetGovernor();
+
+  /** \brief Budget in seconds, base settings become level 0. Without dynamic ROI the levels changing only
+   *         its search windows are skipped*/
+  void configure(double budget, const DetectorTuning &base, bool dynamic_roi);
+
+  /** \brief Add processing time of one frame in seconds, true if level changed*/
+  bool update(double frame_time);
+
+  /** \brief Settings of level, every level is cheaper than the previous one*/
+  DetectorTuning tuning(int level) const;
+
+  /** \brief Threshold window for image downscaled by pyramid_level_offset more levels*/
+  static int scaledBlockSize(int block_size, int pyramid_level_offset);
+
+  int level() const
+  {
+    return level_;
+  }
+
+  double budget() const
+  {
+    return budget_;
+  }
+
+  double averageFrameTime() const
+  {
+    return average_frame_time_;
+  }
+
+  static const int NUM_OF_LEVELS = 8;
+
+private:
+
+  double budget_;
+  double average_frame_time_;
+  int level_;
+  int first_level_;
+  int frames_since_change_;
+  DetectorTuning base_;
+
+  static const int HOLD_FRAMES = 15;
+  static const int FIRST_LEVEL_WITHOUT_ROI = 3;
+  static const int MIN_THRESHOLD_BLOCK_SIZE = 3;
+
+  static constexpr double SMOOTHING = 0.1;
+  static constexpr double RELAX_RATIO = 0.6;
+};
+
+}  //aruco_tracking namespace
+
+#endif //FRAME_BUDGET_GOVERNOR_H
@@ -0,0 +1,123 @@
+/*********************************************************************************************//**
+* @file frame_trace.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <thread_registry.h>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Spans of recent frames for latency profiling. Every thread records into its own ring buffer
+ *         without locks, the oldest spans are overwritten. Rings are dumped in Chrome trace format,
+ *         readable by chrome://tracing and Perfetto */
+class FrameTrace
+{
+public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  enum Span
+  {
+    SPAN_RECEIVE,                                 // Capture stamp to arrival in callback
+    SPAN_CONVERT,
+    SPAN_DETECT,
+    SPAN_MARKER_POSE,                             // Extrinsics of one marker
+    SPAN_MAP,
+    SPAN_POSE,
+    SPAN_PUBLISH,
+    NUM_OF_SPANS
+  };
+
+  FrameTrace();
+
+  /** \brief Spans kept per thread, 0 disables tracing. Called before any span is recorded*/
+  void configure(size_t capacity);
+
+  bool enabled() const
+  {
+    return capacity_ > 0;
+  }
+
+  /** \brief Add span of calling thread, marker_id is -1 for spans of whole frame*/
+  void record(Span span, int camera, uint32_t frame, Clock::time_point start, Clock::time_point end,
+              int marker_id = -1);
+
+  /** \brief Write spans of all threads as Chrome trace JSON, one process per camera*/
+  bool writeChromeTrace(const std::string &filename, const std::vector<std::string> &camera_names);
+
+  static const char *spanName(Span span);
+
+  /** \brief Count requests of signal_number into dumpRequests(), handler only increments a counter.
+   *         Replaces handler of the whole process, opt-in only*/
+  static void installDumpSignal(int signal_number);
+
+  /** \brief Number of dump signals received since start*/
+  static int dumpRequests();
+
+private:
+
+  /** \brief One span packed into words written by relaxed atomics, readers never see torn words*/
+  struct Slot
+  {
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint64_t> duration_ns;
+    std::atomic<uint64_t> info;                   // Span, camera, marker ID and frame number
+  };
+
+  /** \brief Ring written only by its thread. Sequence lock - claimed is raised before a slot is written
+   *         and written after, spans a reader copied while being overwritten are discarded*/
+  struct ThreadRing
+  {
+    explicit ThreadRing(size_t capacity);
+
+    std::atomic<uint64_t> claimed;
+    std::atomic<uint64_t> written;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  size_t capacity_;
+
+  ThreadRegistry<ThreadRing> rings_;
+};
+
+}  //aruco_tracking namespace
+
+#endif //FRAME_TRACE_H
@@ -0,0 +1,55 @@
+/*********************************************************************************************//**
+* @file luma_extraction.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef LUMA_EXTRACTION_H
+#define LUMA_EXTRACTION_H
+
+#include <stdint.h>
+
+#include <sensor_msgs/Image.h>
+#include <opencv2/core/core.hpp>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Copy every second byte of src to dst, n bytes written. Luminance of packed 4:2:2 rows */
+void extractEvenBytes(const uint8_t *src, uint8_t *dst, int n);
+
+/** \brief Luminance of ROI of image written into reused buffer, nothing outside ROI is read.
+ *         YUYV and UYVY planes are extracted directly, RGB and BGR are converted. False if
+ *         encoding is not supported, ROI does not fit into image or step and size of data
+ *         do not match the image */
+bool extractLuma(const sensor_msgs::Image &image, const cv::Rect &roi, cv::Mat &gray);
+
+}  //aruco_tracking namespace
+
+#endif //LUMA_EXTRACTION_H
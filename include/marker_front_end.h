@@ -0,0 +1,119 @@
+/*********************************************************************************************//**
+* @file marker_front_end.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef MARKER_FRONT_END_H
+#define MARKER_FRONT_END_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <aruco/aruco.h>
+#include <opencv2/core/core.hpp>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Mean adaptive threshold of rows, dst is 255 where src + delta <= rounded mean of block_size x block_size
+ *         neighbourhood, borders replicated. Same as cv::adaptiveThreshold with ADAPTIVE_THRESH_MEAN_C and
+ *         THRESH_BINARY_INV for block_size up to MarkerFrontEnd::MAX_BLOCK_SIZE */
+void adaptiveThresholdMeanInv(const uint8_t *src, size_t src_step, uint8_t *dst, size_t dst_step,
+                              int width, int height, int block_size, int delta,
+                              std::vector<uint8_t> &padded_rows, std::vector<uint16_t> &column_sums,
+                              std::vector<int32_t> &row_integral);
+
+/** \brief Copy marker into an existing one, its corner and pose buffers are reused */
+void copyMarker(const aruco::Marker &from, aruco::Marker &to);
+
+/** \brief Thresholding and quad candidates of aruco::MarkerDetector::detect done in the package, candidates are
+ *         identified by aruco. Follows adaptive threshold, contour filtering, subpixel corner refinement and
+ *         duplicate removal of the library so that markers are the same */
+class MarkerFrontEnd
+{
+public:
+
+  MarkerFrontEnd();
+
+  /** \brief Take threshold parameters and size limits of detector, false if detector uses a threshold
+   *         or corner refinement method the front end does not implement */
+  bool configure(aruco::MarkerDetector &detector);
+
+  /** \brief Detect markers in gray image, no poses computed*/
+  void detect(const cv::Mat &gray, std::vector<aruco::Marker> &markers);
+
+  /** \brief Largest block size thresholded exactly, float mean is rounded the same as integer division */
+  static const int MAX_BLOCK_SIZE = 127;
+
+private:
+
+  /** \brief Convex quads with sides longer than MIN_SIDE, anti-clockwise, of pairs with mean corner distance
+   *         below MIN_MEAN_CORNER_DISTANCE the larger one. Number of quads at the front of candidates is
+   *         returned, elements after them are buffers kept for next frames*/
+  size_t findCandidates(cv::Mat &binary, std::vector<std::vector<cv::Point2f> > &candidates);
+
+  /** \brief Candidate warped to canonical image, nearest neighbour as aruco does*/
+  void warp(const cv::Mat &gray, const std::vector<cv::Point2f> &candidate);
+
+  int block_size_;
+  int delta_;
+  float min_size_;
+  float max_size_;
+  bool refine_corners_;
+
+  // Buffers reused by every frame
+  std::vector<uint8_t> padded_rows_;
+  std::vector<uint16_t> column_sums_;
+  std::vector<int32_t> row_integral_;
+  cv::Mat binary_;
+  std::vector<std::vector<cv::Point> > contours_;
+  std::vector<cv::Vec4i> contour_hierarchy_;
+  std::vector<cv::Point> approx_curve_;
+  std::vector<std::vector<cv::Point2f> > candidates_;
+  std::vector<bool> to_remove_;
+  std::vector<aruco::Marker> found_markers_;
+  std::vector<int> marker_order_;
+  cv::Mat canonical_marker_;
+  std::vector<cv::Point2f> corners_;
+
+  static const int WARP_SIZE = 56;
+  static const int MIN_SIDE = 10;
+  static const int REFINE_HALF_WINDOW = 5;
+  static const int REFINE_ITERATIONS = 3;
+
+  static constexpr double APPROX_EPSILON_RATIO = 0.05;
+  static constexpr double REFINE_EPSILON = 0.05;
+  static constexpr float MIN_MEAN_CORNER_DISTANCE = 10;
+  static constexpr double UNKNOWN_POSE = -999999;             // Rvec and Tvec of a new aruco::Marker
+};
+
+}  //aruco_tracking namespace
+
+#endif //MARKER_FRONT_END_H
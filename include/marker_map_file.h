@@ -0,0 +1,71 @@
+/*********************************************************************************************//**
+* @file marker_map_file.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef MARKER_MAP_FILE_H
+#define MARKER_MAP_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Header of binary marker map file */
+struct MarkerMapFileHeader
+{
+  char magic[4];                  // "ATMP"
+  uint32_t version;               // MARKER_MAP_FILE_VERSION
+  uint32_t num_of_markers;        // Number of records following the header
+  uint32_t record_size;           // sizeof(MarkerMapRecord), guards against layout changes
+};
+
+/** \brief One marker of binary marker map file, poses are [x, y, z, qx, qy, qz, qw] */
+struct MarkerMapRecord
+{
+  int32_t marker_id;              // Marker ID
+  int32_t previous_marker_id;     // Parent in marker chain
+  double pose_to_previous[7];     // Pose with respect to previous marker
+  double pose_to_world[7];        // Pose with respect to world's origin
+};
+
+static const uint32_t MARKER_MAP_FILE_VERSION = 1;
+
+/** \brief Write records to file, written to temporary file and renamed so readers never see half a map*/
+bool saveMarkerMap(const std::string &filename, const std::vector<MarkerMapRecord> &records);
+
+/** \brief Read records from file through a read-only memory mapping*/
+bool loadMarkerMap(const std::string &filename, std::vector<MarkerMapRecord> &records);
+
+}  //aruco_tracking namespace
+
+#endif //MARKER_MAP_FILE_H
@@ -0,0 +1,123 @@
+/*********************************************************************************************//**
+* @file marker_store.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef MARKER_STORE_H
+#define MARKER_STORE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <tf/transform_datatypes.h>
+#include <geometry_msgs/Pose.h>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Pose as translation and quaternion [x, y, z, qx, qy, qz, qw], half the size of tf::Transform */
+struct CompactPose
+{
+  double position[3];
+  double orientation[4];
+
+  CompactPose();
+
+  tf::Transform toTf() const;
+  void fromTf(const tf::Transform &transform);
+  void toMsg(geometry_msgs::Pose &pose) const;
+};
+
+static_assert(sizeof(CompactPose) == 7 * sizeof(double), "CompactPose is copied to map file records as is");
+
+/** \brief Markers indexed directly by ID, every attribute kept in its own array so that loops over
+ *         one attribute touch only its memory. ROS messages and TFs are built from it when published */
+class MarkerStore
+{
+public:
+
+  /** \brief Aruco marker IDs are 10 bit */
+  static const int CAPACITY = 1024;
+
+  MarkerStore();
+
+  /** \brief Marker known in the map*/
+  bool contains(int id) const
+  {
+    return (id >= 0) && (id < CAPACITY) && known_[id];
+  }
+
+  /** \brief Add marker with no parent and identity poses, false if ID is out of range*/
+  bool add(int id);
+
+  /** \brief Forget all markers*/
+  void clear();
+
+  /** \brief Known IDs in ascending order*/
+  const std::vector<int> &ids() const { return ids_; }
+
+  /** \brief Set all markers not visible*/
+  void resetVisibility();
+
+  bool visible(int id) const { return visible_[id]; }
+  void setVisible(int id, bool visible) { visible_[id] = visible; }
+
+  /** \brief Parent in marker chain, -1 if not chained yet*/
+  int previous(int id) const { return previous_[id]; }
+  void setPrevious(int id, int previous_id);
+
+  /** \brief Markers whose parent in marker chain is the marker*/
+  const std::vector<int> &next(int id) const { return next_[id]; }
+
+  /** \brief Pose with respect to previous marker*/
+  CompactPose &toPrevious(int id) { return to_previous_[id]; }
+
+  /** \brief Pose with respect to world's origin*/
+  CompactPose &toWorld(int id) { return to_world_[id]; }
+
+  /** \brief Time the marker was last seen by any camera*/
+  const ros::Time &lastSeen(int id) const { return last_seen_[id]; }
+  void setLastSeen(int id, const ros::Time &stamp) { last_seen_[id] = stamp; }
+
+private:
+
+  std::vector<int> ids_;
+  std::vector<uint8_t> known_;
+  std::vector<uint8_t> visible_;
+  std::vector<int> previous_;
+  std::vector<std::vector<int> > next_;
+  std::vector<CompactPose> to_previous_;
+  std::vector<CompactPose> to_world_;
+  std::vector<ros::Time> last_seen_;
+};
+
+}  //aruco_tracking namespace
+
+#endif //MARKER_STORE_H
@@ -0,0 +1,114 @@
+/*********************************************************************************************//**
+* @file pose_graph.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef POSE_GRAPH_H
+#define POSE_GRAPH_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <utility>
+
+#include <tf/transform_datatypes.h>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Sparse pose graph of markers, nodes are marker poses in world and edges relative poses
+ *         of markers seen together. Optimized incrementally by relaxation of the neighbourhood
+ *         of markers seen in the last frame, so cost per frame does not grow with map size */
+class PoseGraph
+{
+public:
+
+  PoseGraph();
+
+  /** \brief Add marker with initial pose in world, fixed node is never moved (world's origin)*/
+  void addNode(int id, const tf::Transform &pose_to_world, bool fixed);
+
+  /** \brief True if marker is already in the graph*/
+  bool hasNode(int id) const;
+
+  /** \brief Pose of marker in world, node must exist*/
+  const tf::Transform &pose(int id) const;
+
+  /** \brief Add measured pose of marker "to" in frame of marker "from", measurements of same pair are averaged*/
+  void addMeasurement(int from, int to, const tf::Transform &from_to_to);
+
+  /** \brief Keep roll, pitch and Z of all poses zero*/
+  void setPlanar(bool planar);
+
+  /** \brief Relax poses of markers up to hops edges away from touched ones, at most max_nodes are moved.
+   *         Ids of moved markers are returned in updated */
+  void optimize(const std::vector<int> &touched, int hops, int max_nodes, int iterations, std::vector<int> &updated);
+
+  /** \brief Remove all nodes and edges*/
+  void clear();
+
+private:
+
+  /** \brief Averaged relative pose of a marker pair, stored in direction of lower ID to higher ID*/
+  struct Edge
+  {
+    tf::Vector3 translation;              // Mean translation
+    tf::Quaternion rotation;              // Mean rotation
+    double weight;                        // Number of measurements, capped
+  };
+
+  struct Node
+  {
+    tf::Transform pose_to_world;          // Current estimate
+    bool fixed;                           // Not moved by optimization
+    std::vector<int> neighbours;          // Markers sharing an edge
+  };
+
+  /** \brief Relative pose of marker "to" in frame of marker "from" from averaged edge*/
+  tf::Transform relativePose(int from, int to, double &weight) const;
+
+  /** \brief Project pose to plane when planar*/
+  tf::Transform constrain(const tf::Transform &pose) const;
+
+  std::map<int, Node> nodes_;
+  std::map<std::pair<int, int>, Edge> edges_;
+  bool planar_;
+
+  // Breadth first search buffers reused by every optimization
+  std::vector<uint8_t> visited_;                  // Flag of every ID, reset after the search
+  std::vector<std::pair<int, int> > open_;        // Markers and their depth, FIFO read by index
+
+  /** \brief Older measurements fade out once edge holds this many of them*/
+  static constexpr double EDGE_MAX_WEIGHT = 100.0;
+};
+
+}  //aruco_tracking namespace
+
+#endif //POSE_GRAPH_H
@@ -0,0 +1,202 @@
+/*********************************************************************************************//**
+* @file spsc_queue.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Bounded lock-free queue for exactly one producer and one consumer thread.
+ *
+ *  push and pop never take a lock. Waiting variants take a mutex only when the queue
+ *  is empty or full and the calling thread has to sleep. */
+template <typename T>
+class SpscQueue
+{
+public:
+
+  explicit SpscQueue(size_t capacity) :
+    buffer_(capacity + 1),
+    head_(0),
+    tail_(0),
+    consumer_waiting_(false),
+    producer_waiting_(false)
+  {
+  }
+
+  /** \brief Append item, false if queue is full*/
+  bool push(const T &item)
+  {
+    if(!tryPush(item))
+      return false;
+    notifyConsumer();
+    return true;
+  }
+
+  /** \brief Take oldest item, false if queue is empty*/
+  bool pop(T &item)
+  {
+    if(!tryPop(item))
+      return false;
+    notifyProducer();
+    return true;
+  }
+
+  /** \brief Append item, sleep while queue is full, false if stopped meanwhile*/
+  bool waitPush(const T &item, const std::atomic<bool> &running)
+  {
+    if(push(item))
+      return true;
+    {
+      std::unique_lock<std::mutex> lock(space_mutex_);
+      producer_waiting_ = true;
+      while(!tryPush(item))
+      {
+        if(!running)
+        {
+          producer_waiting_ = false;
+          return false;
+        }
+        space_condition_.wait(lock);
+      }
+      producer_waiting_ = false;
+    }
+    notifyConsumer();
+    return true;
+  }
+
+  /** \brief Take oldest item, sleep while queue is empty, false if stopped meanwhile*/
+  bool waitPop(T &item, const std::atomic<bool> &running)
+  {
+    if(pop(item))
+      return true;
+    {
+      std::unique_lock<std::mutex> lock(item_mutex_);
+      consumer_waiting_ = true;
+      while(!tryPop(item))
+      {
+        if(!running)
+        {
+          consumer_waiting_ = false;
+          return false;
+        }
+        item_condition_.wait(lock);
+      }
+      consumer_waiting_ = false;
+    }
+    notifyProducer();
+    return true;
+  }
+
+  /** \brief Wake up all sleeping threads, used when stopping*/
+  void wake()
+  {
+    {
+      std::lock_guard<std::mutex> lock(item_mutex_);
+      item_condition_.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(space_mutex_);
+    space_condition_.notify_all();
+  }
+
+private:
+
+  size_t increment(size_t index) const
+  {
+    return (index + 1) % buffer_.size();
+  }
+
+  bool tryPush(const T &item)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = increment(tail);
+    if(next == head_.load())
+      return false;
+    buffer_[tail] = item;
+    tail_.store(next);
+    return true;
+  }
+
+  bool tryPop(T &item)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if(head == tail_.load())
+      return false;
+    item = buffer_[head];
+    head_.store(increment(head));
+    return true;
+  }
+
+  // Sequentially consistent flags pair with the index stores, so a sleeping thread is never missed
+  void notifyConsumer()
+  {
+    if(consumer_waiting_)
+    {
+      std::lock_guard<std::mutex> lock(item_mutex_);
+      item_condition_.notify_one();
+    }
+  }
+
+  void notifyProducer()
+  {
+    if(producer_waiting_)
+    {
+      std::lock_guard<std::mutex> lock(space_mutex_);
+      space_condition_.notify_one();
+    }
+  }
+
+  std::vector<T> buffer_;
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+
+  std::atomic<bool> consumer_waiting_;
+  std::mutex item_mutex_;
+  std::condition_variable item_condition_;
+
+  std::atomic<bool> producer_waiting_;
+  std::mutex space_mutex_;
+  std::condition_variable space_condition_;
+
+  SpscQueue(const SpscQueue &);
+  SpscQueue &operator=(const SpscQueue &);
+
+}; //SpscQueue class
+}  //aruco_tracking namespace
+
+#endif //SPSC_QUEUE_H
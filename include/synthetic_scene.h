@@ -0,0 +1,90 @@
+/*********************************************************************************************//**
+* @file synthetic_scene.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef SYNTHETIC_SCENE_H
+#define SYNTHETIC_SCENE_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <tf/transform_datatypes.h>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Row of markers rendered into images of a calibrated camera moving on a smooth trajectory.
+ *         Ground truth pose of camera is known for every frame */
+class SyntheticScene
+{
+public:
+
+  struct Options
+  {
+    int num_of_markers = 3;                 // Markers in a row
+    int first_marker_id = 1;                // IDs follow in the row, first one becomes world's origin
+    double marker_size = 0.135;             // Side of marker in m
+    double marker_spacing = 0.25;           // Distance of neighbouring marker centers in m
+    double distance = 1.0;                  // Mean distance of camera from markers in m
+    double distance_scale = 1.0;            // Scales distance, markers appear smaller if larger than 1
+    double noise_sigma = 2.0;               // Gaussian noise in gray levels
+    double blur_sigma = 0.0;                // Gaussian blur in px, 0 - sharp image
+    unsigned int seed = 1;                  // Seed of noise, scenes are reproducible
+  };
+
+  SyntheticScene(const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Size &image_size,
+                 const Options &options);
+
+  /** \brief Render frame of a trajectory with num_of_frames frames. Ground truth is camera pose with respect
+   *         to the first marker, in the ROS marker frame the tracker publishes */
+  void render(int frame_index, int num_of_frames, cv::Mat &image, tf::Transform &camera_to_first_marker);
+
+private:
+
+  cv::Mat camera_matrix_;
+  cv::Mat distortion_;
+  cv::Size image_size_;
+  Options options_;
+
+  std::vector<cv::Mat> marker_images_;
+  cv::Mat ideal_image_;
+  cv::Mat distort_map_x_;
+  cv::Mat distort_map_y_;
+  cv::Mat noise_;
+  cv::RNG rng_;
+
+  static const int MARKER_IMAGE_SIZE = 140;
+  static const int BACKGROUND = 200;
+};
+
+}  //aruco_tracking namespace
+
+#endif //SYNTHETIC_SCENE_H
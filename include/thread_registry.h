@@ -0,0 +1,113 @@
+/*********************************************************************************************//**
+* @file thread_registry.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef THREAD_REGISTRY_H
+#define THREAD_REGISTRY_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/function.hpp>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Unique number of a registry, threads cache their entry per registry */
+uint64_t nextThreadRegistryInstance();
+
+/** \brief One entry of type T per thread, written by its thread without locks. Entries live as long
+ *         as the registry, readers visit all of them under the registry lock */
+template<class T>
+class ThreadRegistry
+{
+public:
+
+  ThreadRegistry() :
+    instance_(nextThreadRegistryInstance())
+  {
+  }
+
+  /** \brief Entry of calling thread, constructed from args on first use*/
+  template<class... Args>
+  T &local(Args&&... args)
+  {
+    // Lookup only when the thread switches between instances, e.g. nodelets sharing worker threads
+    thread_local uint64_t cached_instance = 0;
+    thread_local T *cached_entry = NULL;
+    if(cached_instance == instance_)
+      return *cached_entry;
+
+    const std::thread::id thread_id = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+    cached_entry = NULL;
+    for(size_t i = 0; i < entries_.size(); i++)
+      if(entries_[i].first == thread_id)
+        cached_entry = entries_[i].second.get();
+
+    if(cached_entry == NULL)
+    {
+      entries_.push_back(std::make_pair(thread_id, std::unique_ptr<T>(new T(std::forward<Args>(args)...))));
+      cached_entry = entries_.back().second.get();
+    }
+    cached_instance = instance_;
+    return *cached_entry;
+  }
+
+  /** \brief Call function(index, entry) for entries of all threads, in order of registration*/
+  template<class Function>
+  void forEach(Function function)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(size_t i = 0; i < entries_.size(); i++)
+      function(i, *entries_[i].second);
+  }
+
+private:
+
+  const uint64_t instance_;
+
+  std::mutex mutex_;
+  std::vector<std::pair<std::thread::id, std::unique_ptr<T> > > entries_;
+};
+
+/** \brief Write file through a temporary one renamed over it, readers never see a partial file.
+ *         write returns false on failure, nothing is replaced then*/
+bool writeFileAtomically(const std::string &filename, const boost::function<bool (FILE *file)> &write);
+
+}  //aruco_tracking namespace
+
+#endif //THREAD_REGISTRY_H
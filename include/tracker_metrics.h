@@ -0,0 +1,135 @@
+/*********************************************************************************************//**
+* @file tracker_metrics.h
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#ifndef TRACKER_METRICS_H
+#define TRACKER_METRICS_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include <thread_registry.h>
+
+/** \brief Aruco mapping namespace */
+namespace aruco_tracking
+{
+
+/** \brief Counters and latency histograms of the frame loop. Every thread updates its own accumulators
+ *         without locks or shared cache lines, readers sum all threads into a snapshot */
+class TrackerMetrics
+{
+public:
+
+  enum Counter
+  {
+    FRAMES_RECEIVED,
+    FRAMES_DROPPED,
+    FRAMES_PROCESSED,
+    MARKERS_DETECTED,
+    MARKERS_CHAINED,
+    NUM_OF_COUNTERS
+  };
+
+  enum Stage
+  {
+    STAGE_CONVERT,
+    STAGE_DETECT,
+    STAGE_MAP,
+    STAGE_POSE,
+    STAGE_PUBLISH,
+    STAGE_TF_SEND,
+    NUM_OF_STAGES
+  };
+
+  /** \brief Upper bounds of buckets double from FIRST_BUCKET_BOUND, last bucket is unbounded */
+  static const int NUM_OF_BUCKETS = 16;
+  static constexpr double FIRST_BUCKET_BOUND = 0.00005;
+
+  /** \brief Latency distribution of one stage */
+  struct Histogram
+  {
+    uint64_t buckets[NUM_OF_BUCKETS];             // Samples per bucket, not cumulative
+    uint64_t count;                               // Number of samples
+    double sum;                                   // Sum of samples in seconds
+  };
+
+  /** \brief Sum of all threads at one moment */
+  struct Snapshot
+  {
+    uint64_t counters[NUM_OF_COUNTERS];
+    Histogram stages[NUM_OF_STAGES];
+  };
+
+  TrackerMetrics();
+
+  /** \brief Add to counter of calling thread*/
+  void count(Counter counter, uint64_t n = 1);
+
+  /** \brief Add stage duration in seconds to histogram of calling thread*/
+  void observe(Stage stage, double seconds);
+
+  /** \brief Sum accumulators of all threads*/
+  void snapshot(Snapshot &snapshot);
+
+  /** \brief Difference of two snapshots, activity in between*/
+  static void difference(const Snapshot &current, const Snapshot &previous, Snapshot &result);
+
+  /** \brief Upper bound of bucket in seconds*/
+  static double bucketBound(int bucket);
+
+  /** \brief Percentile estimated as upper bound of bucket containing it*/
+  static double percentile(const Histogram &histogram, double p);
+
+  static const char *counterName(Counter counter);
+  static const char *stageName(Stage stage);
+
+  /** \brief Write snapshot in Prometheus text exposition format, replaced atomically for scrapers*/
+  static bool writePrometheus(const std::string &filename, const Snapshot &snapshot);
+
+private:
+
+  /** \brief Accumulators written only by their thread, relaxed atomics so that readers see whole values*/
+  struct ThreadAccumulator
+  {
+    ThreadAccumulator();
+
+    std::atomic<uint64_t> counters[NUM_OF_COUNTERS];
+    std::atomic<uint64_t> buckets[NUM_OF_STAGES][NUM_OF_BUCKETS];
+    std::atomic<uint64_t> sum_ns[NUM_OF_STAGES];
+    char padding[64];                             // Neighbouring accumulators never share a cache line
+  };
+
+  ThreadRegistry<ThreadAccumulator> accumulators_;
+};
+
+}  //aruco_tracking namespace
+
+#endif //TRACKER_METRICS_H
@@ -0,0 +1,47 @@
+#!/bin/bash
+# Accuracy-vs-speed regression of the speed options on a synthetic scene with known ground truth.
+# Needs a running roscore. Every mode writes <output_dir>/<mode>.json, exit code is nonzero
+# if any mode loses markers or exceeds the error limits.
+#
+#   synthetic_suite.sh [output_dir] [frames]
+#
+# The same modes run in the package tests as test/synthetic_suite.test, keep both lists in sync.
+
+OUTPUT_DIR=${1:-synthetic_suite}
+FRAMES=${2:-300}
+MAX_TRANSLATION_ERROR=${MAX_TRANSLATION_ERROR:-0.02}
+MAX_ROTATION_ERROR=${MAX_ROTATION_ERROR:-2.0}
+
+CALIBRATION=$(rospack find aruco_tracking)/data/cal.ini
+
+declare -A MODES
+MODES[default]=""
+MODES[roi]="_roi_allowed:=true _roi_x:=320 _roi_y:=120 _roi_w:=640 _roi_h:=480"
+MODES[pyramid_level]="_pyramid_level:=1"
+MODES[detection_tiles]="_detection_tiles_x:=2 _detection_tiles_y:=2"
+MODES[dynamic_roi]="_dynamic_roi:=true"
+MODES[detection_period]="_detection_period:=3"
+MODES[joint_pnp_off]="_joint_pnp:=false"
+MODES[fast_front_end]="_fast_front_end:=true _fast_front_end_verify:=true"
+MODES[frame_budget]="_frame_budget_ms:=5 _dynamic_roi:=true"
+
+mkdir -p "$OUTPUT_DIR"
+FAILED=0
+for MODE in default roi pyramid_level detection_tiles dynamic_roi detection_period joint_pnp_off fast_front_end frame_budget
+do
+  # Benchmark node is anonymous, parameters of a previous mode do not leak into the next one
+  rosrun aruco_tracking aruco_tracking_benchmark --synthetic "$FRAMES" \
+    --max_translation_error "$MAX_TRANSLATION_ERROR" --max_rotation_error "$MAX_ROTATION_ERROR" \
+    --output "$OUTPUT_DIR/$MODE.json" \
+    _calibration_file:="$CALIBRATION" _marker_size:=0.135 \
+    ${MODES[$MODE]} > /dev/null
+
+  if [ $? -eq 0 ]; then
+    echo "$MODE: passed"
+  else
+    echo "$MODE: FAILED"
+    FAILED=1
+  fi
+done
+
+exit $FAILED
@@ -39,155 +39,1560 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace aruco_tracking
 {
 
-ArucoTracking::ArucoTracking(ros::NodeHandle *nh) :
-  listener_ (new tf::TransformListener),  // Initialize TF Listener
+/** \brief Seconds elapsed since start, for stage timing */
+static double
+secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** \brief Copy markers into existing elements, their corner and pose buffers are reused */
+static void
+copyMarkers(const std::vector<aruco::Marker> &from, std::vector<aruco::Marker> &to)
+{
+  to.resize(from.size());
+  for(size_t i = 0; i < from.size(); i++)
+    copyMarker(from[i], to[i]);
+}
+
+/** \brief Set next TF in place, frame names keep capacity of the previous frame */
+static void
+setTransform(std::vector<tf::StampedTransform> &transforms, size_t &count, const tf::Transform &transform,
+             const ros::Time &stamp, const std::string &parent, const std::string &child)
+{
+  if(count == transforms.size())
+    transforms.push_back(tf::StampedTransform());
+
+  tf::StampedTransform &stamped = transforms[count++];
+  stamped.setData(transform);
+  stamped.stamp_ = stamp;
+  stamped.frame_id_ = parent;
+  stamped.child_frame_id_ = child;
+}
+
+/** \brief Bilinear lookup of undistorted position, points outside the map are clamped to its border */
+static cv::Point2f
+undistortPoint(const cv::Mat &undistort_map, const cv::Point2f &point)
+{
+  const float x = std::min(std::max(point.x, 0.0f), float(undistort_map.cols - 1));
+  const float y = std::min(std::max(point.y, 0.0f), float(undistort_map.rows - 1));
+  const int x0 = std::min(int(x), undistort_map.cols - 2);
+  const int y0 = std::min(int(y), undistort_map.rows - 2);
+  const float ax = x - x0;
+  const float ay = y - y0;
+
+  const cv::Point2f *row0 = undistort_map.ptr<cv::Point2f>(y0);
+  const cv::Point2f *row1 = undistort_map.ptr<cv::Point2f>(y0 + 1);
+  return (row0[x0] * (1 - ax) + row0[x0 + 1] * ax) * (1 - ay) + (row1[x0] * (1 - ax) + row1[x0 + 1] * ax) * ay;
+}
+
+/** \brief Runs candidate detection of several image regions in parallel, every region has its own detector */
+class RegionDetectionBody : public cv::ParallelLoopBody
+{
+public:
+
+  RegionDetectionBody(const cv::Mat &image, const std::vector<cv::Rect> &regions,
+                      std::vector<aruco::MarkerDetector> &detectors, std::vector<std::vector<aruco::Marker> > &markers) :
+    image_(image),
+    regions_(regions),
+    detectors_(detectors),
+    markers_(markers)
+  {
+  }
+
+  virtual void operator()(const cv::Range &range) const
+  {
+    for(int i = range.start; i < range.end; i++)
+    {
+      // No camera parameters, poses are computed once duplicates from region borders are merged
+      detectors_[i].detect(image_(regions_[i]), markers_[i], aruco::CameraParameters(), -1);
+
+      // Region coordinates to image coordinates
+      const cv::Point2f offset(regions_[i].x, regions_[i].y);
+      for(size_t j = 0; j < markers_[i].size(); j++)
+        for(size_t k = 0; k < markers_[i][j].size(); k++)
+          markers_[i][j][k] += offset;
+    }
+  }
+
+private:
+
+  const cv::Mat &image_;
+  const std::vector<cv::Rect> &regions_;
+  std::vector<aruco::MarkerDetector> &detectors_;
+  std::vector<std::vector<aruco::Marker> > &markers_;
+
+}; //RegionDetectionBody class
+
+ArucoTracking::ArucoTracking(ros::NodeHandle *nh, ros::NodeHandle *private_nh) :
   num_of_markers_ (10),                   // Number of used markers
   marker_size_(0.1),                      // Marker size in m
   calib_filename_("empty"),               // Calibration filepath
   space_type_ ("plane"),                  // Space type - 2D plane
   roi_allowed_ (false),                   // ROI not allowed by default
+  tiles_x_ (1),                           // Whole image detected at once by default
+  tiles_y_ (1),                           // Whole image detected at once by default
+  tile_overlap_ (100),                    // Overlap of neighbouring tiles in px
+  dynamic_roi_ (false),                   // Whole image detected every frame by default
+  dynamic_roi_margin_ (0.5),              // Search window grows by half of marker size
+  dynamic_roi_full_scan_period_ (15),     // Whole image scanned every 15th frame
+  detection_period_ (1),                  // Detector runs on every frame by default
+  pyramid_level_ (0),                     // Detection in full resolution by default
+  expected_marker_pixels_ (100),          // Expected marker side in px for automatic pyramid level
+  save_map_on_exit_ (true),               // Map saved on exit if map file set
+  joint_pnp_ (true),                      // Camera pose from all visible markers at once
+  tf_publish_rate_ (0),                   // TFs sent with every frame
+  visualization_rate_ (5),                // RViz cubes refreshed 5 times per second
+  metrics_rate_ (1),                      // Diagnostics published once per second
+  fast_front_end_ (false),                // Markers detected by aruco by default
+  fast_front_end_verify_ (false),         // Front end not compared with aruco by default
+  frame_budget_ms_ (0),                   // Detector settings fixed by default
+  trace_buffer_size_ (0),                 // No tracing by default
+  trace_file_ ("/tmp/aruco_tracking_trace.json"),
+  trace_dump_signal_ (false),             // Handlers of other nodelets in the process kept by default
+  headless_ (false),                      // OpenCV window shown by default
+  multi_camera_ (false),                  // Single camera by default
+  pipeline_enabled_ (false),              // Stages run in series in image callback by default
+  pipeline_block_ (false),                // Newest frame wins by default
+  pipeline_queue_size_ (2),               // Frames waiting between stages
+  pipeline_running_ (true),               // Pipeline threads run until destruction
+  debug_running_ (true),                  // Debug image thread runs until destruction
+  debug_pending_ (false),                 // No debug image waiting for rendering
+  debug_camera_ (NULL),                   // No camera handed over debug image yet
   first_marker_detected_(false),          // First marker not detected by defualt
-  lowest_marker_id_(-1),                  // Lowest marker ID
-  closest_camera_index_(0)                // Reset closest camera index
+  lowest_marker_id_(-1)                   // Lowest marker ID
 
 {
   double temp_marker_size;
 
   //Parse params from launch file
-  nh->getParam("/aruco_tracking/calibration_file", calib_filename_);
-  nh->getParam("/aruco_tracking/marker_size", temp_marker_size);
-  nh->getParam("/aruco_tracking/num_of_markers", num_of_markers_);
-  nh->getParam("/aruco_tracking/space_type",space_type_);
-  nh->getParam("/aruco_tracking/roi_allowed",roi_allowed_);
-  nh->getParam("/aruco_tracking/roi_x",roi_x_);
-  nh->getParam("/aruco_tracking/roi_y",roi_y_);
-  nh->getParam("/aruco_tracking/roi_w",roi_w_);
-  nh->getParam("/aruco_tracking/roi_h",roi_h_);
+  private_nh->getParam("calibration_file", calib_filename_);
+  private_nh->getParam("marker_size", temp_marker_size);
+  private_nh->getParam("num_of_markers", num_of_markers_);
+  private_nh->getParam("space_type",space_type_);
+  private_nh->getParam("roi_allowed",roi_allowed_);
+  private_nh->getParam("roi_x",roi_x_);
+  private_nh->getParam("roi_y",roi_y_);
+  private_nh->getParam("roi_w",roi_w_);
+  private_nh->getParam("roi_h",roi_h_);
+  private_nh->getParam("headless",headless_);
+  private_nh->getParam("detection_tiles_x",tiles_x_);
+  private_nh->getParam("detection_tiles_y",tiles_y_);
+  private_nh->getParam("detection_tile_overlap",tile_overlap_);
+  private_nh->getParam("dynamic_roi",dynamic_roi_);
+  private_nh->getParam("dynamic_roi_margin",dynamic_roi_margin_);
+  private_nh->getParam("dynamic_roi_full_scan_period",dynamic_roi_full_scan_period_);
+  private_nh->getParam("detection_period",detection_period_);
+  private_nh->getParam("pyramid_level",pyramid_level_);
+  private_nh->getParam("expected_marker_pixels",expected_marker_pixels_);
+  private_nh->getParam("map_file",map_file_);
+  private_nh->getParam("save_map_on_exit",save_map_on_exit_);
+  private_nh->getParam("joint_pnp",joint_pnp_);
+  private_nh->getParam("tf_publish_rate",tf_publish_rate_);
+  private_nh->getParam("visualization_rate",visualization_rate_);
+  private_nh->getParam("metrics_rate",metrics_rate_);
+  private_nh->getParam("metrics_file",metrics_file_);
+  private_nh->getParam("fast_front_end",fast_front_end_);
+  private_nh->getParam("fast_front_end_verify",fast_front_end_verify_);
+  private_nh->getParam("frame_budget_ms",frame_budget_ms_);
+  private_nh->getParam("trace_buffer_size",trace_buffer_size_);
+  private_nh->getParam("trace_file",trace_file_);
+  private_nh->getParam("trace_dump_signal",trace_dump_signal_);
+  private_nh_ = *private_nh;
+  private_nh->getParam("pipeline_enabled",pipeline_enabled_);
+  private_nh->getParam("pipeline_queue_size",pipeline_queue_size_);
+
+  std::string drop_policy = "newest_wins";
+  private_nh->getParam("pipeline_drop_policy",drop_policy);
+  if(drop_policy == "block")
+    pipeline_block_ = true;
+  else if(drop_policy != "newest_wins")
+    ROS_WARN_STREAM("Unknown pipeline_drop_policy " << drop_policy << ", using newest_wins");
+  pipeline_queue_size_ = std::max(pipeline_queue_size_, 1);
+  tiles_x_ = std::max(tiles_x_, 1);
+  tiles_y_ = std::max(tiles_y_, 1);
 
   // Double to float conversion
   marker_size_ = float(temp_marker_size);
 
-  if(calib_filename_ == "empty")
+  // Allowed IDs with their sizes, any ID of marker_size_ if not set
+  allowed_ids_.set();
+  marker_sizes_.assign(MarkerStore::CAPACITY, marker_size_);
+  XmlRpc::XmlRpcValue markers_param;
+  if(private_nh->getParam("markers", markers_param))
+    parseMarkers(markers_param);
+
+  // List of cameras sharing one marker map, single camera on "/image_raw" if not set
+  XmlRpc::XmlRpcValue cameras_param;
+  if(private_nh->getParam("cameras", cameras_param))
+    multi_camera_ = parseCameras(cameras_param);
+
+  if(multi_camera_ == false)
+  {
+    boost::shared_ptr<CameraContext> camera(new CameraContext);
+    camera->image_topic = "/image_raw";
+    camera->calib_filename = calib_filename_;
+    camera->extrinsics.setIdentity();
+    cameras_.push_back(camera);
+  }
+
+  if(cameras_[0]->calib_filename == "empty")
     ROS_WARN("Calibration filename empty! Check the launch file paths");
   else
   {
     ROS_INFO_STREAM("Calibration file path: " << calib_filename_ );
     ROS_INFO_STREAM("Number of markers: " << num_of_markers_);
     ROS_INFO_STREAM("Marker Size: " << marker_size_);
+    ROS_INFO_STREAM("Allowed marker IDs: " << allowed_ids_.count());
     ROS_INFO_STREAM("Type of space: " << space_type_);
     ROS_INFO_STREAM("ROI allowed: " << roi_allowed_);
     ROS_INFO_STREAM("ROI x-coor: " << roi_x_);
     ROS_INFO_STREAM("ROI y-coor: " << roi_x_);
     ROS_INFO_STREAM("ROI width: "  << roi_w_);
     ROS_INFO_STREAM("ROI height: " << roi_h_);
+    ROS_INFO_STREAM("Headless: " << headless_);
+    ROS_INFO_STREAM("Detection tiles: " << tiles_x_ << "x" << tiles_y_ << ", overlap " << tile_overlap_);
+    ROS_INFO_STREAM("Dynamic ROI: " << dynamic_roi_ << ", margin " << dynamic_roi_margin_
+                    << ", full scan period " << dynamic_roi_full_scan_period_);
+    ROS_INFO_STREAM("Detection period: " << detection_period_ << " frames, optical flow in between");
+    ROS_INFO_STREAM("Pyramid level: " << pyramid_level_ << ", expected marker size " << expected_marker_pixels_ << " px");
+    ROS_INFO_STREAM("Map file: " << map_file_);
+    ROS_INFO_STREAM("Joint PnP: " << joint_pnp_);
+    ROS_INFO_STREAM("TF publish rate: " << tf_publish_rate_ << " Hz (0 - every frame)");
+    ROS_INFO_STREAM("Visualization rate: " << visualization_rate_ << " Hz");
+    ROS_INFO_STREAM("Metrics rate: " << metrics_rate_ << " Hz, metrics file: " << metrics_file_);
+    ROS_INFO_STREAM("Fast front end: " << fast_front_end_ << ", verified against aruco: " << fast_front_end_verify_);
+    ROS_INFO_STREAM("Frame budget: " << frame_budget_ms_ << " ms (0 - detector settings fixed)");
+    ROS_INFO_STREAM("Trace buffer size: " << trace_buffer_size_ << " spans per thread (0 - no tracing), trace file: " << trace_file_
+                    << ", dumped on SIGUSR1: " << trace_dump_signal_);
+    ROS_INFO_STREAM("Number of cameras: " << cameras_.size());
+    ROS_INFO_STREAM("Pipeline enabled: " << pipeline_enabled_);
+    ROS_INFO_STREAM("Pipeline drop policy: " << (pipeline_block_ ? "block" : "newest_wins"));
+  }
+
+  //ROS publishers
+  marker_visualization_pub_ = nh->advertise<visualization_msgs::MarkerArray>("aruco_markers",1);
+
+  // Cubes for RVIZ - markers, published apart from image processing
+  if(visualization_rate_ > 0)
+    visualization_timer_ = nh->createTimer(ros::Duration(1.0 / visualization_rate_),
+                                           &ArucoTracking::visualizationTimerCallback, this);
+
+  // Frame loop metrics, exported apart from image processing
+  if(metrics_rate_ > 0)
+  {
+    diagnostics_pub_ = nh->advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    metrics_.snapshot(metrics_previous_);
+    metrics_previous_time_ = std::chrono::steady_clock::now();
+    metrics_timer_ = nh->createTimer(ros::Duration(1.0 / metrics_rate_), &ArucoTracking::metricsTimerCallback, this);
+  }
+
+  // Spans of recent frames, dumped on request by service
+  trace_dump_requests_ = FrameTrace::dumpRequests();
+  if(trace_buffer_size_ > 0)
+  {
+    trace_.configure(trace_buffer_size_);
+    dump_trace_service_ = private_nh->advertiseService("dump_trace", &ArucoTracking::dumpTraceCallback, this);
+
+    // Signal handler is process wide, in a nodelet manager it replaces handlers of other nodelets.
+    // Handler only counts, timer writes
+    if(trace_dump_signal_ == true)
+    {
+      FrameTrace::installDumpSignal(TRACE_DUMP_SIGNAL);
+      trace_timer_ = nh->createTimer(ros::Duration(TRACE_POLL_PERIOD), &ArucoTracking::traceTimerCallback, this);
+    }
+  }
+
+  pose_graph_.setPlanar(space_type_ == "plane");
+
+  // TF frame names interned once, no string formatting per frame
+  marker_frame_names_.resize(MarkerStore::CAPACITY);
+  marker_globe_frame_names_.resize(MarkerStore::CAPACITY);
+  for(int i = 0; i < MarkerStore::CAPACITY; i++)
+  {
+    marker_frame_names_[i] = "marker_" + std::to_string(i);
+    marker_globe_frame_names_[i] = "marker_globe_" + std::to_string(i);
+  }
+
+  // Warm start from saved map, world frame is known before first image
+  if(!map_file_.empty())
+  {
+    loadMap(map_file_);
+    save_map_service_ = private_nh->advertiseService("save_map", &ArucoTracking::saveMapCallback, this);
+  }
+
+  // Rotation from Aruco marker frame to ROS marker frame, used by every arucoMarker2Tf call
+  rotate_to_ros_ = (cv::Mat_<float>(3,3) << -1.0, 0.0, 0.0,
+                                             0.0, 0.0, 1.0,
+                                             0.0, 1.0, 0.0);
+
+  image_transport::ImageTransport it(*nh);
+  for(size_t i = 0; i < cameras_.size(); i++)
+  {
+    CameraContext &camera = *cameras_[i];
+    camera.index = i;
+    camera.next_sequence = 0;
+    camera.closest_camera_index = 0;
+    camera.frames_since_full_scan = 0;
+    camera.frames_since_detection = 0;
+    camera.front_end_seconds = 0;
+    camera.detector_seconds = 0;
+    camera.verified_frames = 0;
+    camera.mismatched_frames = 0;
+
+    // Front end refines corners by cornerSubPix, detector does the same so that results match
+    camera.front_end_enabled = false;
+    if(fast_front_end_ == true)
+    {
+      camera.detector.setCornerRefinementMethod(aruco::MarkerDetector::SUBPIX);
+      camera.front_end_enabled = camera.front_end.configure(camera.detector);
+      if(camera.front_end_enabled == false)
+        ROS_WARN_STREAM("Fast front end does not support detector settings of camera " << i << ", aruco detects markers");
+    }
+
+    // Configured settings are level 0 of the governor
+    double threshold_block_size, threshold_constant;
+    camera.detector.getThresholdParams(threshold_block_size, threshold_constant);
+    camera.tuning.threshold_block_size = int(threshold_block_size);
+    camera.tuning.threshold_constant = threshold_constant;
+    camera.detector.getMinMaxSize(camera.tuning.min_marker_size, camera.tuning.max_marker_size);
+    camera.tuning.roi_margin = dynamic_roi_margin_;
+    camera.tuning.full_scan_period = dynamic_roi_full_scan_period_;
+    camera.governor.configure(frame_budget_ms_ / 1000.0, camera.tuning, dynamic_roi_);
+    camera.governor_level = 0;
+    camera.applied_governor_level = 0;
+
+    camera.window_name = camera.name.empty() ? std::string("Mono8") : camera.name;
+    camera.camera_frame = cameraTopic(camera, "camera_position");
+
+    // Every camera estimates the rig on its own, one TF child frame must have a single publisher
+    camera.rig_frame = camera.name.empty() ? std::string("rig_position") : "rig_position_" + camera.name;
+
+    // Camera pose above every marker is its own, frames in namespace of the camera
+    camera.marker_camera_poses.resize(MarkerStore::CAPACITY);
+    camera.marker_camera_known.assign(MarkerStore::CAPACITY, false);
+    camera.marker_camera_frames.resize(MarkerStore::CAPACITY);
+    for(int j = 0; j < MarkerStore::CAPACITY; j++)
+      camera.marker_camera_frames[j] = cameraTopic(camera, "camera_" + std::to_string(j));
+
+    // Per camera publishers
+    camera.marker_msg_pub = nh->advertise<aruco_tracking::ArucoMarker>(cameraTopic(camera, "aruco_poses"),1);
+
+    // Overlay image, rendered only while somebody subscribes
+    camera.debug_image_pub = it.advertise(cameraTopic(camera, "debug_image"), 1);
+
+    // Settings chosen by the governor, latched so that late subscribers see the current ones
+    if(frame_budget_ms_ > 0)
+    {
+      camera.detector_settings_pub = nh->advertise<aruco_tracking::DetectorSettings>(cameraTopic(camera, "detector_settings"), 1, true);
+      publishDetectorSettings(camera, ros::Time::now());
+    }
+
+    //Parse data from calibration file
+    parseCalibrationFile(camera.calib_filename, camera.calib_params, camera.undistort_map);
+
+    // Markers are detected in ROI coordinates, principal point moves with ROI origin
+    if(roi_allowed_ == true)
+    {
+      camera.calib_params.CameraMatrix.at<float>(0,2) -= roi_x_;
+      camera.calib_params.CameraMatrix.at<float>(1,2) -= roi_y_;
+    }
+
+    // Corners undistorted by map are solved without distortion. Assignment deep-copies the matrices,
+    // so the copy is taken after the ROI shift above and later changes of calib_params do not reach it
+    camera.pose_params = camera.calib_params;
+    if(!camera.undistort_map.empty())
+      camera.pose_params.Distorsion = cv::Mat::zeros(camera.calib_params.Distorsion.size(),
+                                                     camera.calib_params.Distorsion.type());
+
+    // Frames in flight, every stage and queue slot can hold one, serial mode uses the first one
+    const size_t num_of_frames = pipeline_enabled_ ? (pipeline_queue_size_ + PIPELINE_NUM_OF_STAGES) : 1;
+    camera.frames.resize(num_of_frames);
+    camera.free_frames.reset(new SpscQueue<Frame *>(num_of_frames));
+    camera.detect_queue.reset(new SpscQueue<Frame *>(num_of_frames));
+    camera.pose_queue.reset(new SpscQueue<Frame *>(num_of_frames));
+    camera.publish_queue.reset(new SpscQueue<Frame *>(num_of_frames));
+
+    // Preallocate per-frame containers so steady state frames reuse their capacity
+    for(size_t j = 0; j < camera.frames.size(); j++)
+    {
+      camera.frames[j].markers.reserve(num_of_markers_);
+      camera.free_frames->push(&camera.frames[j]);
+    }
+    // Outgoing messages allocated once, a new one is made only while subscribers hold all of them
+    camera.marker_msg_pool.resize(MARKER_MSG_POOL_SIZE + num_of_frames);
+    for(size_t j = 0; j < camera.marker_msg_pool.size(); j++)
+      camera.marker_msg_pool[j] = newMarkerMsg();
+    camera.marker_msg_pool_slot = 0;
+
+    //Initialize OpenCV window
+    if(headless_ == false)
+      cv::namedWindow(camera.window_name, CV_WINDOW_AUTOSIZE);
+
+    // Image subscriber, callbacks of different cameras may run in parallel on the spinner threads
+    camera.image_sub = it.subscribe(camera.image_topic, 1, boost::bind(&ArucoTracking::imageCallback, this, _1, camera.index));
+  }
+
+  // Stage threads, frames of one camera stay in order
+  if(pipeline_enabled_ == true)
+  {
+    for(size_t i = 0; i < cameras_.size(); i++)
+    {
+      CameraContext &camera = *cameras_[i];
+      camera.detect_thread = std::thread(&ArucoTracking::detectThread, this, &camera);
+      camera.pose_thread = std::thread(&ArucoTracking::poseThread, this, &camera);
+      camera.publish_thread = std::thread(&ArucoTracking::publishThread, this, &camera);
+    }
+  }
+
+  // Low priority thread rendering debug images
+  debug_thread_ = std::thread(&ArucoTracking::debugImageThread, this);
+}
+
+ArucoTracking::~ArucoTracking()
+{
+  // Callbacks of timers and services use members torn down below, stopping waits for running ones
+  visualization_timer_.stop();
+  metrics_timer_.stop();
+  trace_timer_.stop();
+  save_map_service_.shutdown();
+  dump_trace_service_.shutdown();
+
+  if(!map_file_.empty() && (save_map_on_exit_ == true))
+    saveMap(map_file_);
+
+  pipeline_running_ = false;
+  for(size_t i = 0; i < cameras_.size(); i++)
+  {
+    CameraContext &camera = *cameras_[i];
+    camera.image_sub.shutdown();
+    camera.free_frames->wake();
+    camera.detect_queue->wake();
+    camera.pose_queue->wake();
+    camera.publish_queue->wake();
+    if(camera.detect_thread.joinable())
+      camera.detect_thread.join();
+    if(camera.pose_thread.joinable())
+      camera.pose_thread.join();
+    if(camera.publish_thread.joinable())
+      camera.publish_thread.join();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(debug_mutex_);
+    debug_running_ = false;
+  }
+  debug_condition_.notify_one();
+  debug_thread_.join();
+}
+
+bool
+ArucoTracking::parseCameras(XmlRpc::XmlRpcValue &cameras_param)
+{
+  if((cameras_param.getType() != XmlRpc::XmlRpcValue::TypeArray) || (cameras_param.size() == 0))
+  {
+    ROS_WARN("Parameter cameras has to be a non-empty list, using single camera");
+    return false;
+  }
+
+  for(int i = 0; i < cameras_param.size(); i++)
+  {
+    XmlRpc::XmlRpcValue &camera_param = cameras_param[i];
+    if(!camera_param.hasMember("name") || !camera_param.hasMember("image_topic") || !camera_param.hasMember("calibration_file"))
+    {
+      ROS_ERROR_STREAM("Camera " << i << " needs name, image_topic and calibration_file, skipping it");
+      continue;
+    }
+
+    boost::shared_ptr<CameraContext> camera(new CameraContext);
+    camera->name = static_cast<std::string>(camera_param["name"]);
+    camera->image_topic = static_cast<std::string>(camera_param["image_topic"]);
+    camera->calib_filename = static_cast<std::string>(camera_param["calibration_file"]);
+
+    // Camera pose with respect to rig as [x, y, z, qx, qy, qz, qw]
+    camera->extrinsics.setIdentity();
+    if(camera_param.hasMember("extrinsics"))
+    {
+      XmlRpc::XmlRpcValue &extrinsics = camera_param["extrinsics"];
+      if((extrinsics.getType() == XmlRpc::XmlRpcValue::TypeArray) && (extrinsics.size() == 7))
+      {
+        double values[7];
+        for(int j = 0; j < 7; j++)
+          values[j] = (extrinsics[j].getType() == XmlRpc::XmlRpcValue::TypeInt) ?
+                      double(static_cast<int>(extrinsics[j])) : static_cast<double>(extrinsics[j]);
+        camera->extrinsics.setOrigin(tf::Vector3(values[0], values[1], values[2]));
+        camera->extrinsics.setRotation(tf::Quaternion(values[3], values[4], values[5], values[6]).normalized());
+      }
+      else
+        ROS_WARN_STREAM("Extrinsics of camera " << camera->name << " must be [x, y, z, qx, qy, qz, qw], using identity");
+    }
+
+    ROS_INFO_STREAM("Camera " << camera->name << " on topic " << camera->image_topic);
+    cameras_.push_back(camera);
+  }
+
+  return !cameras_.empty();
+}
+
+bool
+ArucoTracking::parseMarkers(XmlRpc::XmlRpcValue &markers_param)
+{
+  if((markers_param.getType() != XmlRpc::XmlRpcValue::TypeArray) || (markers_param.size() == 0))
+  {
+    ROS_WARN("Parameter markers has to be a non-empty list, allowing all IDs");
+    return false;
+  }
+
+  // Entry is an ID, or id with optional size
+  allowed_ids_.reset();
+  for(int i = 0; i < markers_param.size(); i++)
+  {
+    XmlRpc::XmlRpcValue &marker_param = markers_param[i];
+    int id = -1;
+    float size = marker_size_;
+    if(marker_param.getType() == XmlRpc::XmlRpcValue::TypeInt)
+      id = static_cast<int>(marker_param);
+    else if((marker_param.getType() == XmlRpc::XmlRpcValue::TypeStruct) && marker_param.hasMember("id"))
+    {
+      id = static_cast<int>(marker_param["id"]);
+      if(marker_param.hasMember("size"))
+      {
+        XmlRpc::XmlRpcValue &size_param = marker_param["size"];
+        size = (size_param.getType() == XmlRpc::XmlRpcValue::TypeInt) ?
+               float(static_cast<int>(size_param)) : float(static_cast<double>(size_param));
+      }
+    }
+
+    if((id < 0) || (id >= MarkerStore::CAPACITY) || (size <= 0))
+    {
+      ROS_ERROR_STREAM("Marker " << i << " needs id in 0.." << MarkerStore::CAPACITY - 1 << " and positive size, skipping it");
+      continue;
+    }
+
+    allowed_ids_.set(id);
+    marker_sizes_[id] = size;
+    ROS_DEBUG_STREAM("Marker " << id << " of size " << size << " m");
+  }
+
+  // Nothing valid, accepting nothing would silently disable tracking
+  if(allowed_ids_.none())
+  {
+    allowed_ids_.set();
+    return false;
+  }
+  return true;
+}
+
+std::string
+ArucoTracking::cameraTopic(const CameraContext &camera, const std::string &topic)
+{
+  return camera.name.empty() ? topic : camera.name + "/" + topic;
+}
+
+bool
+ArucoTracking::parseCalibrationFile(std::string calib_filename, aruco::CameraParameters &calib_params, cv::Mat &undistort_map)
+{
+  sensor_msgs::CameraInfo camera_calibration_data;
+  std::string camera_name = "camera";
+
+  camera_calibration_parsers::readCalibrationIni(calib_filename, camera_name, camera_calibration_data);
+
+  // Calibration data, copied by calib_params
+  cv::Mat intrinsics(3, 3, CV_64F);
+  cv::Mat distortion_coeff = cv::Mat::zeros(5, 1, CV_64F);
+  cv::Size image_size(camera_calibration_data.width, camera_calibration_data.height);
+
+  for(size_t i = 0; i < 3; i++)
+    for(size_t j = 0; j < 3; j++)
+    intrinsics.at<double>(i,j) = camera_calibration_data.K.at(3*i+j);
+
+  for(size_t i = 0; i < std::min(camera_calibration_data.D.size(), size_t(5)); i++)
+    distortion_coeff.at<double>(i,0) = camera_calibration_data.D[i];
+
+  ROS_DEBUG_STREAM("Image width: " << image_size.width);
+  ROS_DEBUG_STREAM("Image height: " << image_size.height);
+  ROS_DEBUG_STREAM("Intrinsics:" << std::endl << intrinsics);
+  ROS_DEBUG_STREAM("Distortion: " << distortion_coeff);
+
+
+  //Load parameters to calib_params for aruco detection
+  calib_params.setParams(intrinsics, distortion_coeff, image_size);
+
+  // Undistorted position of every pixel with the model aruco uses, corners are looked up instead of undistorted
+  undistort_map.release();
+  if((image_size.width > 1) && (image_size.height > 1) && (cv::countNonZero(calib_params.Distorsion) > 0))
+  {
+    std::vector<cv::Point2f> pixels;
+    pixels.reserve(image_size.area());
+    for(int y = 0; y < image_size.height; y++)
+      for(int x = 0; x < image_size.width; x++)
+        pixels.push_back(cv::Point2f(x, y));
+
+    std::vector<cv::Point2f> undistorted;
+    cv::undistortPoints(pixels, undistorted, calib_params.CameraMatrix, calib_params.Distorsion,
+                        cv::noArray(), calib_params.CameraMatrix);
+    undistort_map = cv::Mat(undistorted, true).reshape(2, image_size.height);
+  }
+
+  //Simple check if calibration data meets expected values
+  if ((intrinsics.at<double>(2,2) == 1) && (distortion_coeff.at<double>(4,0) == 0))
+  {
+    ROS_INFO_STREAM("Calibration data loaded successfully");
+    return true;
+  }
+  else
+  {
+    ROS_WARN("Wrong calibration data, check calibration file and filepath");
+    return false;
+  }
+}
+
+bool
+ArucoTracking::loadMap(const std::string &filename)
+{
+  std::vector<MarkerMapRecord> records;
+  if(!loadMarkerMap(filename, records))
+  {
+    ROS_WARN_STREAM("Not able to load marker map " << filename << ", map starts empty");
+    return false;
+  }
+
+  //------------------------------------------------------
+  // IDs are used as indices, file is rejected as a whole if any of them is not valid
+  //------------------------------------------------------
+  std::vector<uint8_t> in_file(MarkerStore::CAPACITY, 0);
+  int num_of_first_markers = 0;
+  for(size_t i = 0; i < records.size(); i++)
+  {
+    const int id = records[i].marker_id;
+    if((id < 0) || (id >= MarkerStore::CAPACITY) || in_file[id])
+    {
+      ROS_ERROR_STREAM("Marker ID " << id << " in map file " << filename << " out of range or repeated, map starts empty");
+      return false;
+    }
+    in_file[id] = 1;
+    if(records[i].previous_marker_id == THIS_IS_FIRST_MARKER)
+      num_of_first_markers++;
+  }
+
+  for(size_t i = 0; i < records.size(); i++)
+  {
+    const int previous_id = records[i].previous_marker_id;
+    if((previous_id != THIS_IS_FIRST_MARKER) &&
+       ((previous_id < 0) || (previous_id >= MarkerStore::CAPACITY) || !in_file[previous_id]))
+    {
+      ROS_ERROR_STREAM("Parent " << previous_id << " of marker " << records[i].marker_id << " not in map file "
+                       << filename << ", map starts empty");
+      return false;
+    }
+  }
+
+  if(num_of_first_markers != 1)
+  {
+    ROS_ERROR_STREAM("Map file " << filename << " has " << num_of_first_markers
+                     << " markers at world's origin instead of one, map starts empty");
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(map_mutex_);
+  for(size_t i = 0; i < records.size(); i++)
+  {
+    const int id = records[i].marker_id;
+    markers_.add(id);
+    markers_.setPrevious(id, records[i].previous_marker_id);
+    std::memcpy(&markers_.toPrevious(id), records[i].pose_to_previous, sizeof(CompactPose));
+    std::memcpy(&markers_.toWorld(id), records[i].pose_to_world, sizeof(CompactPose));
+
+    // First marker identifies world's origin
+    if(records[i].previous_marker_id == THIS_IS_FIRST_MARKER)
+    {
+      lowest_marker_id_ = id;
+      first_marker_detected_ = true;
+    }
+    pose_graph_.addNode(id, markers_.toWorld(id).toTf(), records[i].previous_marker_id == THIS_IS_FIRST_MARKER);
+  }
+
+  // Chain edges keep the loaded map rigid until new measurements arrive
+  for(size_t i = 0; i < records.size(); i++)
+  {
+    if(records[i].previous_marker_id != THIS_IS_FIRST_MARKER)
+      pose_graph_.addMeasurement(records[i].previous_marker_id, records[i].marker_id,
+                                 markers_.toPrevious(records[i].marker_id).toTf());
+  }
+
+  ROS_INFO_STREAM("Marker map with " << records.size() << " markers loaded, world's origin is marker " << lowest_marker_id_);
+  return true;
+}
+
+bool
+ArucoTracking::saveMap(const std::string &filename)
+{
+  std::vector<MarkerMapRecord> records;
+  {
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    const std::vector<int> &ids = markers_.ids();
+    for(size_t i = 0; i < ids.size(); i++)
+    {
+      // Markers not chained to world have no pose yet
+      if(markers_.previous(ids[i]) == -1)
+        continue;
+
+      // Map file record and compact pose share the same layout
+      MarkerMapRecord record;
+      record.marker_id = ids[i];
+      record.previous_marker_id = markers_.previous(ids[i]);
+      std::memcpy(record.pose_to_previous, &markers_.toPrevious(ids[i]), sizeof(CompactPose));
+      std::memcpy(record.pose_to_world, &markers_.toWorld(ids[i]), sizeof(CompactPose));
+      records.push_back(record);
+    }
+  }
+
+  if(!saveMarkerMap(filename, records))
+  {
+    ROS_ERROR_STREAM("Not able to save marker map " << filename);
+    return false;
+  }
+
+  ROS_INFO_STREAM("Marker map with " << records.size() << " markers saved to " << filename);
+  return true;
+}
+
+bool
+ArucoTracking::saveMapCallback(std_srvs::Empty::Request &request, std_srvs::Empty::Response &response)
+{
+  return saveMap(map_file_);
+}
+
+bool
+ArucoTracking::dumpTrace()
+{
+  std::vector<std::string> camera_names(cameras_.size());
+  for(size_t i = 0; i < cameras_.size(); i++)
+    camera_names[i] = cameras_[i]->name;
+
+  if(!trace_.writeChromeTrace(trace_file_, camera_names))
+  {
+    ROS_ERROR_STREAM("Not able to write trace file " << trace_file_);
+    return false;
+  }
+
+  ROS_INFO_STREAM("Trace written to " << trace_file_);
+  return true;
+}
+
+bool
+ArucoTracking::dumpTraceCallback(std_srvs::Empty::Request &request, std_srvs::Empty::Response &response)
+{
+  return dumpTrace();
+}
+
+void
+ArucoTracking::traceTimerCallback(const ros::TimerEvent &event)
+{
+  // Signals received since last check are served by one dump
+  const int requests = FrameTrace::dumpRequests();
+  if(requests == trace_dump_requests_)
+    return;
+
+  trace_dump_requests_ = requests;
+  dumpTrace();
+}
+
+void
+ArucoTracking::traceSpan(FrameTrace::Span span, const CameraContext &camera, const Frame &frame,
+                         const std::chrono::steady_clock::time_point &start, int marker_id)
+{
+  if(trace_.enabled())
+    trace_.record(span, camera.index, frame.sequence, start, std::chrono::steady_clock::now(), marker_id);
+}
+
+void
+ArucoTracking::imageCallback(const sensor_msgs::ImageConstPtr &original_image, int camera_index)
+{
+  CameraContext &camera = *cameras_[camera_index];
+  const std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+  metrics_.count(TrackerMetrics::FRAMES_RECEIVED);
+
+  //------------------------------------------------------
+  // Serial mode, all stages in this callback
+  //------------------------------------------------------
+  if(pipeline_enabled_ == false)
+  {
+    Frame &frame = camera.frames[0];
+    frame.received = received;
+    if(convertImage(camera, original_image, frame))
+    {
+      detectMarkers(camera, frame);
+      processImage(camera, frame);
+      publishFrame(camera, frame);
+    }
+    else
+      metrics_.count(TrackerMetrics::FRAMES_DROPPED);
+    frame.cv_ptr.reset();
+    return;
+  }
+
+  //------------------------------------------------------
+  // Pipeline mode, this callback is the convert stage
+  //------------------------------------------------------
+  Frame *frame = NULL;
+  if(pipeline_block_ == true)
+  {
+    if(!camera.free_frames->waitPop(frame, pipeline_running_))
+      return;
+  }
+  else if(!camera.free_frames->pop(frame))
+  {
+    ROS_DEBUG_STREAM("Pipeline of camera " << camera.index << " is full, frame dropped");
+    metrics_.count(TrackerMetrics::FRAMES_DROPPED);
+    return;
+  }
+
+  frame->received = received;
+  frame->dropped = !convertImage(camera, original_image, *frame);
+  camera.detect_queue->push(frame);
+}
+
+void
+ArucoTracking::setFrameTimingCallback(const FrameTimingCallback &callback)
+{
+  frame_timing_callback_ = callback;
+}
+
+bool
+ArucoTracking::convertImage(CameraContext &camera, const sensor_msgs::ImageConstPtr &original_image, Frame &frame)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  frame.header = original_image->header;
+  frame.sequence = camera.next_sequence++;
+
+  // Outputs carry capture time of the image, arrival time if the driver does not stamp
+  if(frame.header.stamp.isZero())
+    frame.header.stamp = ros::Time::now();
+
+  // Capture to arrival, known only if stamps are of the same clock as this node
+  if(trace_.enabled())
+  {
+    const double age = (ros::Time::now() - frame.header.stamp).toSec() - secondsSince(frame.received);
+    std::chrono::steady_clock::time_point captured = frame.received;
+    if(!ros::Time::isSimTime() && (age > 0) && (age < TRACE_MAX_RECEIVE_AGE))
+      captured -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(age));
+    trace_.record(FrameTrace::SPAN_RECEIVE, camera.index, frame.sequence, captured, frame.received);
+  }
+
+  const cv::Rect roi = roi_allowed_ ? cv::Rect(roi_x_,roi_y_,roi_w_,roi_h_) :
+                                      cv::Rect(0, 0, original_image->width, original_image->height);
+
+  // YUYV, UYVY and color images - luminance of ROI only, straight into the reused buffer of frame
+  if((original_image->encoding != sensor_msgs::image_encodings::MONO8) &&
+     extractLuma(*original_image, roi, frame.luma))
+  {
+    frame.image = frame.luma;
+    frame.timing.convert = secondsSince(start);
+    traceSpan(FrameTrace::SPAN_CONVERT, camera, frame, start);
+    return true;
+  }
+
+  //Create cv_brigde instance, MONO8 images are shared with the publisher without any copy
+  try
+  {
+    if(original_image->encoding == sensor_msgs::image_encodings::MONO8)
+      frame.cv_ptr=cv_bridge::toCvShare(original_image);
+    else
+      frame.cv_ptr=cv_bridge::toCvCopy(original_image, sensor_msgs::image_encodings::MONO8);
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    ROS_ERROR("Not able to convert sensor_msgs::Image to OpenCV::Mat format %s", e.what());
+    return false;
+  }
+
+  // sensor_msgs::Image to OpenCV Mat structure, read-only view
+  frame.image = frame.cv_ptr->image;
+
+  // region of interest, still a view into the received image
+  if(roi_allowed_==true)
+    frame.image = frame.cv_ptr->image(cv::Rect(roi_x_,roi_y_,roi_w_,roi_h_));
+
+  frame.timing.convert = secondsSince(start);
+  traceSpan(FrameTrace::SPAN_CONVERT, camera, frame, start);
+  return true;
+}
+
+void
+ArucoTracking::detectMarkers(CameraContext &camera, Frame &frame)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  // Governor level is chosen by publish stage, detector is changed only here between two detections
+  const int governor_level = camera.governor_level;
+  if(governor_level != camera.applied_governor_level)
+    applyDetectorTuning(camera, governor_level);
+
+  // Between detections corners are only tracked, detector runs again when tracking quality drops
+  if(detection_period_ > 1)
+  {
+    cv::buildOpticalFlowPyramid(frame.image, camera.flow_pyramid, cv::Size(FLOW_WINDOW_SIZE, FLOW_WINDOW_SIZE),
+                                FLOW_PYRAMID_LEVELS);
+
+    const bool tracked = (camera.frames_since_detection + 1 < detection_period_) &&
+                         trackMarkersOpticalFlow(camera, frame);
+    if(tracked == true)
+      camera.frames_since_detection++;
+    else
+    {
+      detectMarkersFullFrame(camera, frame);
+      camera.frames_since_detection = 0;
+    }
+
+    // Current frame is the reference of next tracking
+    camera.flow_previous_pyramid.swap(camera.flow_pyramid);
+    copyMarkers(frame.markers, camera.flow_markers);
+
+    if(dynamic_roi_ == true)
+      updateTrackedMarkers(camera, frame.markers);
+    computeMarkerPoses(camera, frame);
+    frame.timing.detect = secondsSince(start);
+    traceSpan(FrameTrace::SPAN_DETECT, camera, frame, start);
+    return;
+  }
+
+  // While markers are tracked only predicted search windows are detected
+  bool full_scan = true;
+  if((dynamic_roi_ == true) && (camera.tracked_markers.empty() == false) &&
+     (camera.frames_since_full_scan < camera.tuning.full_scan_period))
+  {
+    predictSearchWindows(camera, frame.image.size());
+    detectMarkersInRegions(camera, frame, camera.search_windows);
+
+    // Tracking lost, scan whole image in the same frame
+    full_scan = trackingLost(camera, frame.markers);
+    if(full_scan == true)
+      ROS_DEBUG_STREAM("Camera " << camera.index << " lost tracked marker, scanning whole image");
+  }
+
+  if(full_scan == true)
+  {
+    detectMarkersFullFrame(camera, frame);
+    camera.frames_since_full_scan = 0;
+  }
+  else
+    camera.frames_since_full_scan++;
+
+  if(dynamic_roi_ == true)
+    updateTrackedMarkers(camera, frame.markers);
+  computeMarkerPoses(camera, frame);
+  frame.timing.detect = secondsSince(start);
+  traceSpan(FrameTrace::SPAN_DETECT, camera, frame, start);
+}
+
+void
+ArucoTracking::computeMarkerPoses(CameraContext &camera, Frame &frame)
+{
+  // Corners in raw image coordinates were kept by tracking, from now on they are undistorted
+  if(!camera.undistort_map.empty())
+  {
+    const cv::Point2f roi_offset = roi_allowed_ ? cv::Point2f(roi_x_, roi_y_) : cv::Point2f(0, 0);
+    for(size_t i = 0; i < frame.markers.size(); i++)
+      for(size_t j = 0; j < frame.markers[i].size(); j++)
+        frame.markers[i][j] = undistortPoint(camera.undistort_map, frame.markers[i][j] + roi_offset) - roi_offset;
+  }
+
+  for(size_t i = 0; i < frame.markers.size(); i++)
+  {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    frame.markers[i].calculateExtrinsics(marker_sizes_[frame.markers[i].id], camera.pose_params, false);
+    traceSpan(FrameTrace::SPAN_MARKER_POSE, camera, frame, start, frame.markers[i].id);
+  }
+}
+
+bool
+ArucoTracking::trackMarkersOpticalFlow(CameraContext &camera, Frame &frame)
+{
+  if(camera.flow_markers.empty() || camera.flow_previous_pyramid.empty())
+    return false;
+
+  camera.flow_previous_points.clear();
+  for(size_t i = 0; i < camera.flow_markers.size(); i++)
+    camera.flow_previous_points.insert(camera.flow_previous_points.end(),
+                                       camera.flow_markers[i].begin(), camera.flow_markers[i].end());
+
+  // Forward and backward tracking, corner which does not come back to its start is not trusted
+  const cv::Size window(FLOW_WINDOW_SIZE, FLOW_WINDOW_SIZE);
+  cv::calcOpticalFlowPyrLK(camera.flow_previous_pyramid, camera.flow_pyramid, camera.flow_previous_points,
+                           camera.flow_points, camera.flow_status, camera.flow_error, window, FLOW_PYRAMID_LEVELS);
+  cv::calcOpticalFlowPyrLK(camera.flow_pyramid, camera.flow_previous_pyramid, camera.flow_points,
+                           camera.flow_back_points, camera.flow_back_status, camera.flow_error, window, FLOW_PYRAMID_LEVELS);
+
+  // Quality check - every corner tracked both ways, marker still a convex quad of similar area
+  copyMarkers(camera.flow_markers, frame.markers);
+  size_t point = 0;
+  for(size_t i = 0; i < frame.markers.size(); i++)
+  {
+    aruco::Marker &marker = frame.markers[i];
+    const double previous_area = cv::contourArea(marker);
+    for(size_t j = 0; j < marker.size(); j++, point++)
+    {
+      const cv::Point2f back_error = camera.flow_back_points[point] - camera.flow_previous_points[point];
+      if(!camera.flow_status[point] || !camera.flow_back_status[point] ||
+         (back_error.dot(back_error) > FLOW_MAX_BACK_ERROR * FLOW_MAX_BACK_ERROR))
+        return false;
+      marker[j] = camera.flow_points[point];
+    }
+
+    const double area = cv::contourArea(marker);
+    if(!cv::isContourConvex(marker) || (area < FLOW_MIN_AREA_RATIO * previous_area) ||
+       (previous_area < FLOW_MIN_AREA_RATIO * area))
+      return false;
+  }
+  return true;
+}
+
+void
+ArucoTracking::detectMarkersFullFrame(CameraContext &camera, Frame &frame)
+{
+  // Large frames are split into tiles detected in parallel
+  if(tiles_x_ * tiles_y_ > 1)
+  {
+    // Tiles are computed again only if image size changes
+    if(camera.tiles_image_size != frame.image.size())
+      computeTiles(camera, frame.image.size());
+
+    detectMarkersInRegions(camera, frame, camera.tiles);
+    return;
+  }
+
+  // Candidates found in downscaled image, corners refined in full resolution
+  const int pyramid_level = std::min(pyramidLevel() + camera.tuning.pyramid_level_offset, int(PYRAMID_MAX_LEVEL));
+  if(pyramid_level > 0)
+  {
+    detectMarkersPyramid(camera, frame, pyramid_level);
+    return;
+  }
+
+  // Detector lives in the camera context and marker container in the frame, so their buffers are reused
+  detectCandidates(camera, frame.image, frame.markers);
+  rejectMarkers(frame.markers);
+}
+
+void
+ArucoTracking::rejectMarkers(std::vector<aruco::Marker> &markers)
+{
+  size_t kept = 0;
+  for(size_t i = 0; i < markers.size(); i++)
+  {
+    const int id = markers[i].id;
+    if((id < 0) || (id >= MarkerStore::CAPACITY) || !allowed_ids_[id])
+    {
+      ROS_DEBUG_STREAM("Marker ID " << id << " not allowed, ignored");
+      continue;
+    }
+    if(kept != i)
+      markers[kept] = markers[i];
+    kept++;
+  }
+  markers.resize(kept);
+}
+
+void
+ArucoTracking::detectCandidates(CameraContext &camera, const cv::Mat &image, std::vector<aruco::Marker> &markers)
+{
+  if(camera.front_end_enabled == false)
+  {
+    camera.detector.detect(image, markers, aruco::CameraParameters(), -1);
+    return;
+  }
+
+  if(fast_front_end_verify_ == false)
+  {
+    camera.front_end.detect(image, markers);
+    return;
+  }
+
+  //------------------------------------------------------
+  // Verification, both on the same image, front end result is used
+  //------------------------------------------------------
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  camera.front_end.detect(image, markers);
+  camera.front_end_seconds += secondsSince(start);
+
+  start = std::chrono::steady_clock::now();
+  camera.detector.detect(image, camera.verify_markers, aruco::CameraParameters(), -1);
+  camera.detector_seconds += secondsSince(start);
+  camera.verified_frames++;
+
+  // Both are sorted by ID
+  bool same = (markers.size() == camera.verify_markers.size());
+  for(size_t i = 0; (i < markers.size()) && (same == true); i++)
+  {
+    same = (markers[i].id == camera.verify_markers[i].id);
+    for(size_t j = 0; (j < markers[i].size()) && (same == true); j++)
+      same = (cv::norm(markers[i][j] - camera.verify_markers[i][j]) <= FRONT_END_VERIFY_TOLERANCE);
+  }
+
+  if(same == false)
+  {
+    camera.mismatched_frames++;
+    ROS_WARN_STREAM_THROTTLE(1.0, "Front end of camera " << camera.index << " found " << markers.size()
+                             << " markers, aruco " << camera.verify_markers.size() << " or different corners");
+  }
+
+  ROS_INFO_STREAM_THROTTLE(10.0, "Front end of camera " << camera.index << ": "
+                           << 1000 * camera.front_end_seconds / camera.verified_frames << " ms, aruco "
+                           << 1000 * camera.detector_seconds / camera.verified_frames << " ms per frame, speedup "
+                           << camera.detector_seconds / std::max(camera.front_end_seconds, 1e-9) << ", "
+                           << camera.mismatched_frames << " of " << camera.verified_frames << " frames differ");
+}
+
+void
+ArucoTracking::applyDetectorTuning(CameraContext &camera, int level)
+{
+  camera.tuning = camera.governor.tuning(level);
+  camera.applied_governor_level = level;
+
+  // Full scans of whole image run on added pyramid levels, tiles and search windows stay in full resolution
+  const int block_size = (tiles_x_ * tiles_y_ > 1) ? camera.tuning.threshold_block_size :
+      FrameBudgetGovernor::scaledBlockSize(camera.tuning.threshold_block_size, camera.tuning.pyramid_level_offset);
+  camera.detector.setThresholdParams(block_size, camera.tuning.threshold_constant);
+  camera.detector.setMinMaxSize(camera.tuning.min_marker_size, camera.tuning.max_marker_size);
+  if(fast_front_end_ == true)
+    camera.front_end_enabled = camera.front_end.configure(camera.detector);
+}
+
+void
+ArucoTracking::publishDetectorSettings(CameraContext &camera, const ros::Time &stamp)
+{
+  const DetectorTuning tuning = camera.governor.tuning(camera.governor.level());
+
+  aruco_tracking::DetectorSettings settings;
+  settings.header.stamp = stamp;
+  settings.header.frame_id = camera.camera_frame;
+  settings.frame_budget = camera.governor.budget();
+  settings.average_frame_time = camera.governor.averageFrameTime();
+  settings.level = camera.governor.level();
+  settings.pyramid_level = std::min(pyramidLevel() + tuning.pyramid_level_offset, int(PYRAMID_MAX_LEVEL));
+  settings.threshold_block_size = tuning.threshold_block_size;
+  settings.threshold_constant = tuning.threshold_constant;
+  settings.min_marker_size = tuning.min_marker_size;
+  settings.max_marker_size = tuning.max_marker_size;
+  settings.roi_margin = tuning.roi_margin;
+  settings.full_scan_period = tuning.full_scan_period;
+  camera.detector_settings_pub.publish(settings);
+}
+
+int
+ArucoTracking::pyramidLevel()
+{
+  // Level may be changed at runtime, cached parameter costs no master round-trip
+  int pyramid_level = pyramid_level_;
+  private_nh_.getParamCached("pyramid_level", pyramid_level);
+
+  // Automatic level keeps expected marker above size still reliably decoded
+  if(pyramid_level < 0)
+  {
+    pyramid_level = 0;
+    double marker_pixels = expected_marker_pixels_;
+    while((marker_pixels / 2 >= PYRAMID_MIN_MARKER_PIXELS) && (pyramid_level < PYRAMID_MAX_LEVEL))
+    {
+      marker_pixels /= 2;
+      pyramid_level++;
+    }
+  }
+
+  return std::min(pyramid_level, int(PYRAMID_MAX_LEVEL));
+}
+
+void
+ArucoTracking::detectMarkersPyramid(CameraContext &camera, Frame &frame, int pyramid_level)
+{
+  // Pyramid levels are reused buffers, level 0 is the image itself
+  camera.pyramid.resize(pyramid_level + 1);
+  camera.pyramid[0] = frame.image;
+  for(int i = 1; i <= pyramid_level; i++)
+    cv::pyrDown(camera.pyramid[i - 1], camera.pyramid[i]);
+
+  // Thresholding and contours on downscaled image, no poses yet
+  detectCandidates(camera, camera.pyramid[pyramid_level], frame.markers);
+  rejectMarkers(frame.markers);
+
+  const float scale = float(1 << pyramid_level);
+  const cv::Size refine_window(int(scale) + 2, int(scale) + 2);
+  const cv::TermCriteria refine_criteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS,
+                                         PYRAMID_REFINE_ITERATIONS, PYRAMID_REFINE_EPSILON);
+
+  for(size_t i = 0; i < frame.markers.size(); i++)
+  {
+    // Pixel centers of downscaled image to full resolution
+    std::vector<cv::Point2f> &corners = frame.markers[i];
+    for(size_t j = 0; j < corners.size(); j++)
+      corners[j] = cv::Point2f((corners[j].x + 0.5f) * scale - 0.5f, (corners[j].y + 0.5f) * scale - 0.5f);
+
+    cv::cornerSubPix(frame.image, corners, refine_window, cv::Size(-1,-1), refine_criteria);
+  }
+}
+
+void
+ArucoTracking::detectMarkersInRegions(CameraContext &camera, Frame &frame, const std::vector<cv::Rect> &regions)
+{
+  // One detector per region, so regions are detected in parallel
+  if(camera.region_detectors.size() < regions.size())
+  {
+    camera.region_detectors.resize(regions.size());
+    camera.region_markers.resize(regions.size());
+  }
+
+  // Marker size limits are relative to image size, rescale them so regions accept same sizes in px
+  float min_size, max_size;
+  camera.detector.getMinMaxSize(min_size, max_size);
+  const float full_size = std::max(frame.image.cols, frame.image.rows);
+  for(size_t i = 0; i < regions.size(); i++)
+  {
+    // Regions are detected in full resolution, threshold window is the one of level 0 of the pyramid
+    const float region_size = std::max(regions[i].width, regions[i].height);
+    camera.region_detectors[i].setThresholdParams(camera.tuning.threshold_block_size, camera.tuning.threshold_constant);
+    camera.region_detectors[i].setMinMaxSize(std::min(1.0f, min_size * full_size / region_size),
+                                             std::min(1.0f, max_size * full_size / region_size));
+  }
+
+  cv::parallel_for_(cv::Range(0, regions.size()),
+                    RegionDetectionBody(frame.image, regions, camera.region_detectors, camera.region_markers));
+
+  // Merge markers, the one found in overlap of two regions is kept once.
+  // Markers are written into kept elements of the frame, whose buffers are reused
+  size_t num_of_markers = 0;
+  for(size_t i = 0; i < regions.size(); i++)
+  {
+    for(size_t j = 0; j < camera.region_markers[i].size(); j++)
+    {
+      const aruco::Marker &region_marker = camera.region_markers[i][j];
+      if((region_marker.id < 0) || (region_marker.id >= MarkerStore::CAPACITY) || !allowed_ids_[region_marker.id])
+        continue;
+
+      const cv::Point2f center = region_marker.getCenter();
+      const float max_distance = region_marker.getPerimeter() / 8;
+
+      bool duplicate = false;
+      for(size_t k = 0; (k < num_of_markers) && (duplicate == false); k++)
+      {
+        const cv::Point2f difference = frame.markers[k].getCenter() - center;
+        duplicate = (frame.markers[k].id == region_marker.id) &&
+                    (difference.dot(difference) < max_distance * max_distance);
+      }
+
+      if(duplicate == true)
+        continue;
+
+      if(num_of_markers == frame.markers.size())
+        frame.markers.push_back(aruco::Marker());
+      copyMarker(region_marker, frame.markers[num_of_markers++]);
+    }
+  }
+  frame.markers.resize(num_of_markers);
+}
+
+void
+ArucoTracking::computeTiles(CameraContext &camera, const cv::Size &image_size)
+{
+  camera.tiles_image_size = image_size;
+  camera.tiles.clear();
+
+  const int tile_width = (image_size.width + tiles_x_ - 1) / tiles_x_;
+  const int tile_height = (image_size.height + tiles_y_ - 1) / tiles_y_;
+  const cv::Rect image_rect(0, 0, image_size.width, image_size.height);
+
+  for(int y = 0; y < tiles_y_; y++)
+  {
+    for(int x = 0; x < tiles_x_; x++)
+    {
+      // Overlap has to be larger than a marker so that every marker fits whole into some tile
+      cv::Rect tile(x * tile_width - tile_overlap_ / 2, y * tile_height - tile_overlap_ / 2,
+                    tile_width + tile_overlap_, tile_height + tile_overlap_);
+      camera.tiles.push_back(tile & image_rect);
+    }
   }
 
-  //ROS publishers
-  marker_msg_pub_           = nh->advertise<aruco_tracking::ArucoMarker>("aruco_poses",1);
-  marker_visualization_pub_ = nh->advertise<visualization_msgs::Marker>("aruco_markers",1);
-
-  //Parse data from calibration file
-  parseCalibrationFile(calib_filename_);
-
-  //Initialize OpenCV window
-  cv::namedWindow("Mono8", CV_WINDOW_AUTOSIZE);
+  ROS_INFO_STREAM("Camera " << camera.index << " detects in " << camera.tiles.size() << " tiles of "
+                  << tile_width << "x" << tile_height << " px");
 }
 
-ArucoTracking::~ArucoTracking()
+void
+ArucoTracking::predictSearchWindows(CameraContext &camera, const cv::Size &image_size)
 {
- delete listener_;
+  const cv::Rect image_rect(0, 0, image_size.width, image_size.height);
+  camera.search_windows.clear();
+
+  for(size_t i = 0; i < camera.tracked_markers.size(); i++)
+  {
+    const TrackedMarker &tracked = camera.tracked_markers[i];
+
+    // Constant velocity prediction, window grows with marker size and its motion
+    const int margin = int(camera.tuning.roi_margin * std::max(tracked.bounding_box.width, tracked.bounding_box.height) +
+                           std::abs(tracked.velocity.x) + std::abs(tracked.velocity.y));
+    cv::Rect window(tracked.bounding_box.x + int(tracked.velocity.x) - margin,
+                    tracked.bounding_box.y + int(tracked.velocity.y) - margin,
+                    tracked.bounding_box.width + 2 * margin,
+                    tracked.bounding_box.height + 2 * margin);
+    window &= image_rect;
+    if(window.area() > 0)
+      camera.search_windows.push_back(window);
+  }
+
+  // Overlapping windows are merged, so no marker is cut by a window border
+  bool merged = true;
+  while(merged == true)
+  {
+    merged = false;
+    for(size_t i = 0; (i < camera.search_windows.size()) && (merged == false); i++)
+    {
+      for(size_t j = i + 1; (j < camera.search_windows.size()) && (merged == false); j++)
+      {
+        if((camera.search_windows[i] & camera.search_windows[j]).area() > 0)
+        {
+          camera.search_windows[i] |= camera.search_windows[j];
+          camera.search_windows.erase(camera.search_windows.begin() + j);
+          merged = true;
+        }
+      }
+    }
+  }
 }
 
 bool
-ArucoTracking::parseCalibrationFile(std::string calib_filename)
+ArucoTracking::trackingLost(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers)
 {
-  sensor_msgs::CameraInfo camera_calibration_data;
-  std::string camera_name = "camera";
-
-  camera_calibration_parsers::readCalibrationIni(calib_filename, camera_name, camera_calibration_data);
+  for(size_t i = 0; i < camera.tracked_markers.size(); i++)
+  {
+    bool found = false;
+    for(size_t j = 0; (j < real_time_markers.size()) && (found == false); j++)
+      found = (real_time_markers[j].id == camera.tracked_markers[i].marker_id);
 
-  // Alocation of memory for calibration data
-  cv::Mat  *intrinsics       = new(cv::Mat)(3, 3, CV_64F);
-  cv::Mat  *distortion_coeff = new(cv::Mat)(5, 1, CV_64F);
-  cv::Size *image_size       = new(cv::Size);
+    if(found == false)
+      return true;
+  }
+  return false;
+}
 
-  image_size->width = camera_calibration_data.width;
-  image_size->height = camera_calibration_data.height;
+void
+ArucoTracking::updateTrackedMarkers(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers)
+{
+  camera.previous_tracked_markers.swap(camera.tracked_markers);
+  camera.tracked_markers.clear();
 
-  for(size_t i = 0; i < 3; i++)
-    for(size_t j = 0; j < 3; j++)
-    intrinsics->at<double>(i,j) = camera_calibration_data.K.at(3*i+j);
+  for(size_t i = 0; i < real_time_markers.size(); i++)
+  {
+    TrackedMarker tracked;
+    tracked.marker_id = real_time_markers[i].id;
+    tracked.center = real_time_markers[i].getCenter();
+    tracked.bounding_box = cv::boundingRect(real_time_markers[i]);
+    tracked.velocity = cv::Point2f(0, 0);
+
+    // Motion of marker in image since previous frame
+    for(size_t j = 0; j < camera.previous_tracked_markers.size(); j++)
+    {
+      if(camera.previous_tracked_markers[j].marker_id == tracked.marker_id)
+      {
+        tracked.velocity = tracked.center - camera.previous_tracked_markers[j].center;
+        break;
+      }
+    }
+    camera.tracked_markers.push_back(tracked);
+  }
+}
 
-  for(size_t i = 0; i < 5; i++)
-    distortion_coeff->at<double>(i,0) = camera_calibration_data.D.at(i);
+void
+ArucoTracking::publishFrame(CameraContext &camera, Frame &frame)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-  ROS_DEBUG_STREAM("Image width: " << image_size->width);
-  ROS_DEBUG_STREAM("Image height: " << image_size->height);
-  ROS_DEBUG_STREAM("Intrinsics:" << std::endl << *intrinsics);
-  ROS_DEBUG_STREAM("Distortion: " << *distortion_coeff);
+  //------------------------------------------------------
+  // Publish all known markers
+  //------------------------------------------------------
+  if(frame.publish_tfs == true)
+  {
+    const std::chrono::steady_clock::time_point tf_start = std::chrono::steady_clock::now();
+    broadcaster_.sendTransform(frame.transforms);
+    metrics_.observe(TrackerMetrics::STAGE_TF_SEND, secondsSince(tf_start));
+  }
 
+  //------------------------------------------------------
+  // Publish custom marker message
+  //------------------------------------------------------
+  camera.marker_msg_pub.publish(frame.marker_msg);
+  const aruco_tracking::ArucoMarkerConstPtr marker_msg = frame.marker_msg;
+  frame.marker_msg.reset();
 
-  //Load parameters to aruco_calib_param_ for aruco detection
-  aruco_calib_params_.setParams(*intrinsics, *distortion_coeff, *image_size);
+  if(headless_ == false)
+  {
+    // Shared image must not be drawn into, copy only the ROI to a reused buffer
+    frame.image.copyTo(camera.output_image);
+    drawMarkers(camera.output_image, frame.markers, camera.pose_params);
+
+    // Show image, HighGUI is not thread safe
+    std::lock_guard<std::mutex> lock(gui_mutex_);
+    cv::imshow(camera.window_name, camera.output_image);
+    cv::waitKey(CV_WAIT_KEY);
+  }
 
-  //Simple check if calibration data meets expected values
-  if ((intrinsics->at<double>(2,2) == 1) && (distortion_coeff->at<double>(0,4) == 0))
+  // Hand over image for overlay rendering only if anybody listens
+  if(camera.debug_image_pub.getNumSubscribers() > 0)
+    queueDebugImage(camera, frame);
+
+  frame.timing.publish = secondsSince(start);
+  traceSpan(FrameTrace::SPAN_PUBLISH, camera, frame, start);
+
+  // Next settings are chosen from the time a frame occupies the tracker, detect stage applies them.
+  // Stages of the pipeline overlap, its slowest thread limits the frame rate
+  const double frame_time = pipeline_enabled_ ?
+                            std::max(std::max(frame.timing.convert, frame.timing.detect),
+                                     std::max(frame.timing.map + frame.timing.pose, frame.timing.publish)) :
+                            frame.timing.convert + frame.timing.detect + frame.timing.map +
+                            frame.timing.pose + frame.timing.publish;
+  if((frame_budget_ms_ > 0) && camera.governor.update(frame_time))
   {
-    ROS_INFO_STREAM("Calibration data loaded successfully");
-    return true;
+    camera.governor_level = camera.governor.level();
+    publishDetectorSettings(camera, frame.header.stamp);
+    ROS_DEBUG_STREAM("Camera " << camera.index << " average frame time " << camera.governor.averageFrameTime() * 1000
+                     << " ms, detector settings level " << camera.governor.level());
   }
-  else
+
+  metrics_.count(TrackerMetrics::FRAMES_PROCESSED);
+  metrics_.count(TrackerMetrics::MARKERS_DETECTED, frame.markers.size());
+  metrics_.observe(TrackerMetrics::STAGE_CONVERT, frame.timing.convert);
+  metrics_.observe(TrackerMetrics::STAGE_DETECT, frame.timing.detect);
+  metrics_.observe(TrackerMetrics::STAGE_MAP, frame.timing.map);
+  metrics_.observe(TrackerMetrics::STAGE_POSE, frame.timing.pose);
+  metrics_.observe(TrackerMetrics::STAGE_PUBLISH, frame.timing.publish);
+  if(frame_timing_callback_)
+    frame_timing_callback_(camera.index, frame.header, frame.timing, marker_msg);
+}
+
+void
+ArucoTracking::detectThread(CameraContext *camera)
+{
+  Frame *frame = NULL;
+  while(camera->detect_queue->waitPop(frame, pipeline_running_))
   {
-    ROS_WARN("Wrong calibration data, check calibration file and filepath");
-    return false;
+    // Newest frame wins, older waiting frames pass the remaining stages as dropped to keep order
+    if(pipeline_block_ == false)
+    {
+      Frame *newer_frame = NULL;
+      while(camera->detect_queue->pop(newer_frame))
+      {
+        frame->dropped = true;
+        camera->pose_queue->push(frame);
+        frame = newer_frame;
+      }
+    }
+
+    if(frame->dropped == false)
+      detectMarkers(*camera, *frame);
+    camera->pose_queue->push(frame);
   }
 }
 
 void
-ArucoTracking::imageCallback(const sensor_msgs::ImageConstPtr &original_image)
+ArucoTracking::poseThread(CameraContext *camera)
 {
-  //Create cv_brigde instance
-  cv_bridge::CvImagePtr cv_ptr;
-  try
+  Frame *frame = NULL;
+  while(camera->pose_queue->waitPop(frame, pipeline_running_))
   {
-    cv_ptr=cv_bridge::toCvCopy(original_image, sensor_msgs::image_encodings::MONO8);
+    if(frame->dropped == false)
+      processImage(*camera, *frame);
+    camera->publish_queue->push(frame);
   }
-  catch (cv_bridge::Exception& e)
+}
+
+void
+ArucoTracking::publishThread(CameraContext *camera)
+{
+  Frame *frame = NULL;
+  while(camera->publish_queue->waitPop(frame, pipeline_running_))
   {
-    ROS_ERROR("Not able to convert sensor_msgs::Image to OpenCV::Mat format %s", e.what());
-    return;
+    if(frame->dropped == false)
+      publishFrame(*camera, *frame);
+    else
+    {
+      ROS_DEBUG_STREAM("Frame of camera " << camera->index << " dropped in favour of a newer one");
+      metrics_.count(TrackerMetrics::FRAMES_DROPPED);
+    }
+
+    // Release received image and hand frame back to the convert stage
+    frame->cv_ptr.reset();
+    frame->marker_msg.reset();
+    camera->free_frames->push(frame);
   }
+}
 
-  // sensor_msgs::Image to OpenCV Mat structure
-  cv::Mat I = cv_ptr->image;
+void
+ArucoTracking::drawMarkers(cv::Mat &image, std::vector<aruco::Marker> &markers, const aruco::CameraParameters &calib_params)
+{
+  //Draw marker convex, ID, cube and axis
+  for(size_t i = 0; i < markers.size(); i++)
+  {
+    markers[i].draw(image, cv::Scalar(0,0,255), CV_WINDOW_MARKER_LINE_WIDTH);
+    aruco::CvDrawingUtils::draw3dCube(image, markers[i], calib_params);
+    aruco::CvDrawingUtils::draw3dAxis(image, markers[i], calib_params);
+  }
+}
 
-  // region of interest
-  if(roi_allowed_==true)
-    I = cv_ptr->image(cv::Rect(roi_x_,roi_y_,roi_w_,roi_h_));
+void
+ArucoTracking::queueDebugImage(CameraContext &camera, Frame &frame)
+{
+  // Never wait for the renderer, frame is skipped if it is still busy
+  std::unique_lock<std::mutex> lock(debug_mutex_, std::try_to_lock);
+  if(!lock.owns_lock())
+    return;
 
-  //Marker detection
-  processImage(I,I);
+  debug_camera_ = &camera;
+  debug_header_ = frame.header;
+  frame.image.copyTo(debug_gray_);
+  copyMarkers(frame.markers, debug_markers_);
+  debug_pending_ = true;
+  lock.unlock();
+  debug_condition_.notify_one();
+}
 
-  // Show image
-  cv::imshow("Mono8", I);
-  cv::waitKey(10);
+void
+ArucoTracking::debugImageThread()
+{
+#ifdef __linux__
+  // Rendering must never compete with detection
+  struct sched_param param;
+  param.sched_priority = 0;
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+  std::unique_lock<std::mutex> lock(debug_mutex_);
+  while(true)
+  {
+    debug_condition_.wait(lock, [this]{ return debug_pending_ || !debug_running_; });
+    if(!debug_running_)
+      break;
+
+    debug_pending_ = false;
+    cv::cvtColor(debug_gray_, debug_color_, CV_GRAY2BGR);
+    drawMarkers(debug_color_, debug_markers_, debug_camera_->pose_params);
+    debug_camera_->debug_image_pub.publish(cv_bridge::CvImage(debug_header_, sensor_msgs::image_encodings::BGR8,
+                                                              debug_color_).toImageMsg());
+  }
 }
 
 
 bool
-ArucoTracking::processImage(cv::Mat input_image,cv::Mat output_image)
+ArucoTracking::processImage(CameraContext &camera, Frame &frame)
 {
-  aruco::MarkerDetector Detector;
-  std::vector<aruco::Marker> real_time_markers;
+  // Markers were detected by the previous stage, cameras detect in parallel without holding the map
+  std::vector<aruco::Marker> &real_time_markers = frame.markers;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-  //Set visibility flag to false for all markers
-  for (std::map<int, MarkerInfo>::iterator it=markers_.begin(); it!=markers_.end(); ++it)
-  {
-    it->second.visible = false;
-  }
+  // Marker map is shared by all cameras
+  std::lock_guard<std::mutex> lock(map_mutex_);
+
+  // IDs out of range of the marker store or not allowed were rejected by the detect stage
 
-  // Detect markers
-  Detector.detect(input_image,real_time_markers,aruco_calib_params_,marker_size_);
+  //Set visibility flag to false for all markers
+  markers_.resetVisibility();
 
   // If no marker found, print statement
   if(real_time_markers.size() == 0)
@@ -202,41 +1607,40 @@ ArucoTracking::processImage(cv::Mat input_image,cv::Mat output_image)
     detectFirstMarker(real_time_markers);
   }
   //------------------------------------------------------
-  // FOR EVERY MARKER DO
+  // FOR EVERY MARKER DO - fresh camera pose
   //------------------------------------------------------
   for(size_t i = 0; i < real_time_markers.size();i++)
   {
     int current_marker_id = real_time_markers[i].id;
 
-    //Draw marker convex, ID, cube and axis
-    real_time_markers[i].draw(output_image, cv::Scalar(0,0,255),2);
-    aruco::CvDrawingUtils::draw3dCube(output_image,real_time_markers[i], aruco_calib_params_);
-    aruco::CvDrawingUtils::draw3dAxis(output_image,real_time_markers[i], aruco_calib_params_);
-
     // // Existing marker ?
     if(isDetected(current_marker_id))
-    {
       ROS_DEBUG_STREAM("Existing marker with ID: " << current_marker_id << " found");
-      setCurrentCameraPose(real_time_markers[i], current_marker_id, true);
-    }
     else
     {
-      /// new marker
-      MarkerInfo marker;
-      marker.marker_id = current_marker_id;
-      markers_[current_marker_id] = marker;
-      // existing = true;
+      /// new marker, kept in map from now on
+      markers_.add(current_marker_id);
       ROS_DEBUG_STREAM("New marker with ID: " << current_marker_id << " found");
     }
+  }
 
-    // Change visibility flag of new marker
-    markVisible(real_time_markers);
-    //------------ ------------------------------------------
-    if((markers_[current_marker_id].previous_marker_id == -1) && (first_marker_detected_ == true) && (current_marker_id != lowest_marker_id_))
-    {
-      //markers_[current_marker_id].current_camera_tf=arucoMarker2Tf(real_time_markers[i]);
-      setCurrentCameraPose(real_time_markers[i], current_marker_id, false);
+  // Change visibility flag of detected markers
+  markVisible(real_time_markers);
+
+  // Camera poses of all markers first, so chaining never uses a pose from older frame
+  for(size_t i = 0; i < real_time_markers.size();i++)
+    setCurrentCameraPose(camera, real_time_markers[i], real_time_markers[i].id, true);
+
+  //------------------------------------------------------
+  // FOR EVERY MARKER DO - chaining and global pose
+  //------------------------------------------------------
+  for(size_t i = 0; i < real_time_markers.size();i++)
+  {
+    int current_marker_id = real_time_markers[i].id;
 
+    // Only markers not chained yet, relative poses of known markers are kept
+    if((markers_.previous(current_marker_id) == -1) && (first_marker_detected_ == true) && (current_marker_id != lowest_marker_id_))
+    {
       // Flag to keep info if any_known marker_visible in actual image
       bool any_known_marker_visible = false;
 
@@ -249,49 +1653,47 @@ ArucoTracking::processImage(cv::Mat input_image,cv::Mat output_image)
      // New position can be calculated
      if(any_known_marker_visible == true)
      {
-       // Generating TFs for listener
-       publishCameraMarkerTransforms(current_marker_id, last_marker_id);
-        // Save origin and quaternion of calculated TF
-        tf::Vector3 marker_origin = markers_[current_marker_id].tf_to_previous.getOrigin();
-        tf::Quaternion marker_quaternion = markers_[current_marker_id].tf_to_previous.getRotation();
+       // Compose TF between the new marker and the known one
+       computeMarkerToPrevious(camera, current_marker_id, last_marker_id);
         // If plane type selected roll, pitch and Z axis are zero
         if(space_type_ == "plane")
         {
+          CompactPose &to_previous = markers_.toPrevious(current_marker_id);
+          tf::Vector3 marker_origin = to_previous.toTf().getOrigin();
+          tf::Quaternion marker_quaternion = to_previous.toTf().getRotation();
           double roll, pitch, yaw;
           tf::Matrix3x3(marker_quaternion).getRPY(roll,pitch,yaw);
           roll = 0;
           pitch = 0;
           marker_origin.setZ(0);
           marker_quaternion.setRPY(pitch,roll,yaw);
+          to_previous.fromTf(tf::Transform(marker_quaternion, marker_origin));
         }
-
-        markers_[current_marker_id].tf_to_previous.setRotation(marker_quaternion);
-        markers_[current_marker_id].tf_to_previous.setOrigin(marker_origin);
-
-        marker_origin = markers_[current_marker_id].tf_to_previous.getOrigin();
-        markers_[current_marker_id].geometry_msg_to_previous.position.x = marker_origin.getX();
-        markers_[current_marker_id].geometry_msg_to_previous.position.y = marker_origin.getY();
-        markers_[current_marker_id].geometry_msg_to_previous.position.z = marker_origin.getZ();
-        //
-        marker_quaternion = markers_[current_marker_id].tf_to_previous.getRotation();
-        markers_[current_marker_id].geometry_msg_to_previous.orientation.x = marker_quaternion.getX();
-        markers_[current_marker_id].geometry_msg_to_previous.orientation.y = marker_quaternion.getY();
-        markers_[current_marker_id].geometry_msg_to_previous.orientation.z = marker_quaternion.getZ();
-        markers_[current_marker_id].geometry_msg_to_previous.orientation.w = marker_quaternion.getW();
-        //
-        setCameraPose(current_marker_id, true);
-        //
-        // Publish all TFs and markers
-        publishTfs(false);
       }
     }
 
     //------------------------------------------------------
-    // Compute global position of new marker
+    // Compute global position of new marker, pose graph refines it from now on
     //-----------------------------------------------------
-    computeGlobalMarkerPose(current_marker_id);
+    if(!pose_graph_.hasNode(current_marker_id))
+    {
+      computeGlobalMarkerPose(current_marker_id);
+      if(markers_.previous(current_marker_id) != -1)
+      {
+        pose_graph_.addNode(current_marker_id, markers_.toWorld(current_marker_id).toTf(),
+                            current_marker_id == lowest_marker_id_);
+        metrics_.count(TrackerMetrics::MARKERS_CHAINED);
+      }
+    }
   }
 
+  //------------------------------------------------------
+  // Optimize world poses around visible markers
+  //------------------------------------------------------
+  updatePoseGraph(camera, real_time_markers);
+  frame.timing.map = secondsSince(start);
+  traceSpan(FrameTrace::SPAN_MAP, camera, frame, start);
+  start = std::chrono::steady_clock::now();
 
   //After For Loop Code
   //------------------------------------------------------
@@ -299,185 +1701,273 @@ ArucoTracking::processImage(cv::Mat input_image,cv::Mat output_image)
   //------------------------------------------------------
   bool any_markers_visible=false;
   int num_of_visible_markers=0;
-  nearestMarkersToCamera(any_markers_visible, num_of_visible_markers);
+  nearestMarkersToCamera(camera, any_markers_visible, num_of_visible_markers);
 
   //------------------------------------------------------
   // Compute global camera pose
   //------------------------------------------------------
-  computeGlobalCameraPose(any_markers_visible);
-
-  //------------------------------------------------------
-  // Publish all known markers
-  //------------------------------------------------------
-  if(first_marker_detected_ == true)
-    publishTfs(true);
+  computeGlobalCameraPose(camera, real_time_markers, any_markers_visible, num_of_visible_markers, frame.header.stamp);
 
   //------------------------------------------------------
-  // Publish custom marker message
+  // Prepare output for the publish stage
   //------------------------------------------------------
-  publishCustomMarker(any_markers_visible, num_of_visible_markers);
+  frame.world_position_transform = camera.world_position_transform;
 
-  //--------------------------------------
-  // Reset Markers
-  //--------------------------------------
-  for (auto itr = markers_.begin(); itr != markers_.end(); ++itr) {
-    if(itr->first != lowest_marker_id_){
-      markers_.erase(itr->first);
-    }
+  // TFs limited to the configured rate, independent of camera rate
+  const ros::Time now = ros::Time::now();
+  frame.publish_tfs = (first_marker_detected_ == true) &&
+                      ((tf_publish_rate_ <= 0) || ((now - camera.last_tf_publish).toSec() >= 1.0 / tf_publish_rate_));
+  if(frame.publish_tfs == true)
+  {
+    camera.last_tf_publish = now;
+    collectTfs(camera, frame, true);
   }
+  prepareCustomMarker(camera, frame, any_markers_visible, num_of_visible_markers);
+  frame.timing.pose = secondsSince(start);
+  traceSpan(FrameTrace::SPAN_POSE, camera, frame, start);
+
   return true;
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////
 void
 ArucoTracking::knownMarkerInImage(bool &any_known_marker_visible, int &last_marker_id, int current_marker_id)
 {
-  if (markers_[lowest_marker_id_].visible==true)
+  // World's origin preferred, otherwise any visible marker already chained to it
+  if (markers_.visible(lowest_marker_id_)==true)
   {
     any_known_marker_visible = true;
-    markers_[current_marker_id].previous_marker_id = lowest_marker_id_;//it->first;
+    markers_.setPrevious(current_marker_id, lowest_marker_id_);
     last_marker_id = lowest_marker_id_;
+    return;
+  }
+
+  const std::vector<int> &ids = markers_.ids();
+  for (size_t i = 0; i < ids.size(); i++)
+  {
+    if((markers_.visible(ids[i]) == true) && (markers_.previous(ids[i]) != -1) && (ids[i] != current_marker_id))
+    {
+      any_known_marker_visible = true;
+      markers_.setPrevious(current_marker_id, ids[i]);
+      last_marker_id = ids[i];
+      return;
+    }
   }
 }
 //////////////////////////////////////////////////////////////////////////
 void
-ArucoTracking::publishCameraMarkerTransforms(int current_marker_id, int last_marker_id)
+ArucoTracking::computeMarkerToPrevious(CameraContext &camera, int current_marker_id, int last_marker_id)
 {
-  // Naming - TFs
-  std::stringstream camera_tf_id;
-  std::stringstream camera_tf_id_old;
-  std::stringstream marker_tf_id_old;
-
-  camera_tf_id << "camera_" << current_marker_id;
-  camera_tf_id_old << "camera_" << last_marker_id;
-  marker_tf_id_old << "marker_" << last_marker_id;
-  for(char k = 0; k < 10; k++)
+  // Camera pose w.r.t. the known marker composed with the new marker pose w.r.t. the camera
+  markers_.toPrevious(current_marker_id).fromTf(camera.marker_camera_poses[last_marker_id].toTf() *
+                                                camera.marker_camera_poses[current_marker_id].toTf().inverse());
+}
+//////////////////////////////////////////////////////////////////////////
+bool
+ArucoTracking::computeMarkerToWorld(int marker_id, tf::Transform &marker_to_world)
+{
+  // Walk the marker chain down to the first marker, which is identified with world's origin
+  marker_to_world.setIdentity();
+  size_t chain_length = 0;
+  while(marker_id != THIS_IS_FIRST_MARKER)
   {
-    // TF from old marker and its camera
-    broadcaster_.sendTransform(tf::StampedTransform(markers_[last_marker_id].current_camera_tf,ros::Time::now(),
-                                                    marker_tf_id_old.str(),camera_tf_id_old.str()));
+    if(!markers_.contains(marker_id) || (markers_.previous(marker_id) == -1) || (chain_length++ > markers_.ids().size()))
+      return false;
+
+    marker_to_world = markers_.toPrevious(marker_id).toTf() * marker_to_world;
+    marker_id = markers_.previous(marker_id);
+  }
+  return true;
+}
+//////////////////////////////////////////////////////////////////////////
+void
+ArucoTracking::updatePoseGraph(CameraContext &camera, std::vector<aruco::Marker> &real_time_markers)
+{
+  if(first_marker_detected_ == false)
+    return;
 
-    // TF from old camera to new camera
-    broadcaster_.sendTransform(tf::StampedTransform(markers_[current_marker_id].current_camera_tf,ros::Time::now(),
-                                                    camera_tf_id_old.str(),camera_tf_id.str()));
+  // Every pair of markers seen together constrains their relative pose
+  pose_graph_touched_.clear();
+  bool any_measurement = false;
+  for(size_t i = 0; i < real_time_markers.size(); i++)
+  {
+    const int id_i = real_time_markers[i].id;
+    if(!pose_graph_.hasNode(id_i))
+      continue;
+    pose_graph_touched_.push_back(id_i);
 
-    ros::Duration(BROADCAST_WAIT_INTERVAL).sleep();
+    for(size_t j = i + 1; j < real_time_markers.size(); j++)
+    {
+      const int id_j = real_time_markers[j].id;
+      if(!pose_graph_.hasNode(id_j) || (id_i == id_j))
+        continue;
+
+      // Camera pose w.r.t. marker i composed with pose of marker j w.r.t. the camera
+      pose_graph_.addMeasurement(id_i, id_j, camera.marker_camera_poses[id_i].toTf() *
+                                             camera.marker_camera_poses[id_j].toTf().inverse());
+      any_measurement = true;
+    }
   }
 
-   // Calculate TF between two markers
-   listener_->waitForTransform(marker_tf_id_old.str(),camera_tf_id.str(),ros::Time(0),
-                               ros::Duration(WAIT_FOR_TRANSFORM_INTERVAL));
-   try
-   {
-     broadcaster_.sendTransform(tf::StampedTransform(markers_[last_marker_id].current_camera_tf,ros::Time::now(),
-                                                     marker_tf_id_old.str(),camera_tf_id_old.str()));
+  if(!any_measurement)
+    return;
+
+  // Only neighbourhood of visible markers is relaxed, cost does not grow with the map
+  pose_graph_.optimize(pose_graph_touched_, POSE_GRAPH_HOPS, POSE_GRAPH_MAX_NODES, POSE_GRAPH_ITERATIONS,
+                       pose_graph_updated_);
 
-     broadcaster_.sendTransform(tf::StampedTransform(markers_[current_marker_id].current_camera_tf,ros::Time::now(),
-                                                     camera_tf_id_old.str(),camera_tf_id.str()));
+  for(size_t i = 0; i < pose_graph_updated_.size(); i++)
+    markers_.toWorld(pose_graph_updated_[i]).fromTf(pose_graph_.pose(pose_graph_updated_[i]));
 
-     listener_->lookupTransform(marker_tf_id_old.str(),camera_tf_id.str(),ros::Time(0),
-                                markers_[current_marker_id].tf_to_previous);
-   }
-   catch(tf::TransformException &e)
-   {
-     ROS_ERROR("Not able to lookup transform");
-   }
-}
+  // TF tree keeps its chain, relative poses of moved markers and of markers chained to them follow
+  // optimized world poses. Deeper descendants keep theirs, both ends of their links are unchanged
+  for(size_t i = 0; i < pose_graph_updated_.size(); i++)
+  {
+    const int id = pose_graph_updated_[i];
+    updateToPrevious(id);
 
+    const std::vector<int> &next = markers_.next(id);
+    for(size_t j = 0; j < next.size(); j++)
+      updateToPrevious(next[j]);
+  }
+}
+//////////////////////////////////////////////////////////////////////////
+void
+ArucoTracking::updateToPrevious(int marker_id)
+{
+  const int previous_id = markers_.previous(marker_id);
+  if(previous_id < 0)
+    return;
 
+  markers_.toPrevious(marker_id).fromTf(markers_.toWorld(previous_id).toTf().inverse() * markers_.toWorld(marker_id).toTf());
+}
+//////////////////////////////////////////////////////////////////////////
 void
 ArucoTracking::computeGlobalMarkerPose(int current_marker_id)
 {
   if(first_marker_detected_ == true)
   {
-    // Publish all TF five times for listener
-    for(char k = 0; k < 5; k++)
-      publishTfs(false);
-
-    std::stringstream marker_tf_name;
-    marker_tf_name << "marker_" << current_marker_id;
-    listener_->waitForTransform("world",marker_tf_name.str(),ros::Time(0),
-                                ros::Duration(WAIT_FOR_TRANSFORM_INTERVAL));
-    try
+    tf::Transform marker_to_world;
+    if(!computeMarkerToWorld(current_marker_id, marker_to_world))
     {
-      listener_->lookupTransform("world",marker_tf_name.str(),ros::Time(0),
-                                 markers_[current_marker_id].tf_to_world);
+      ROS_DEBUG_STREAM("Marker with ID: " << current_marker_id << " is not chained to world yet");
+      return;
     }
-    catch(tf::TransformException &e)
-    {
-      ROS_ERROR("Not able to lookup transform");
-    }
-
-    // Saving TF to Pose
-    const tf::Vector3 marker_origin = markers_[current_marker_id].tf_to_world.getOrigin();
-    markers_[current_marker_id].geometry_msg_to_world.position.x = marker_origin.getX();
-    markers_[current_marker_id].geometry_msg_to_world.position.y = marker_origin.getY();
-    markers_[current_marker_id].geometry_msg_to_world.position.z = marker_origin.getZ();
-
-    tf::Quaternion marker_quaternion=markers_[current_marker_id].tf_to_world.getRotation();
-    markers_[current_marker_id].geometry_msg_to_world.orientation.x = marker_quaternion.getX();
-    markers_[current_marker_id].geometry_msg_to_world.orientation.y = marker_quaternion.getY();
-    markers_[current_marker_id].geometry_msg_to_world.orientation.z = marker_quaternion.getZ();
-    markers_[current_marker_id].geometry_msg_to_world.orientation.w = marker_quaternion.getW();
+    markers_.toWorld(current_marker_id).fromTf(marker_to_world);
   }
 }
 ///////////////////////////////////////////////////////////////////////////////
 void
-ArucoTracking::computeGlobalCameraPose(bool any_markers_visible)
+ArucoTracking::computeGlobalCameraPose(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers,
+                                       bool any_markers_visible, int num_of_visible_markers, const ros::Time &stamp)
 {
   if((first_marker_detected_ == true) && (any_markers_visible == true))
   {
-    std::stringstream closest_camera_tf_name;
-    closest_camera_tf_name << "camera_" << closest_camera_index_;
+    // Camera pose w.r.t. the closest marker composed with pose of that marker w.r.t. world
+    tf::Transform camera_to_world = markers_.toWorld(camera.closest_camera_index).toTf() *
+                                    camera.marker_camera_poses[camera.closest_camera_index].toTf();
 
-    listener_->waitForTransform("world",closest_camera_tf_name.str(),ros::Time(0),
-                                ros::Duration(WAIT_FOR_TRANSFORM_INTERVAL));
-    try
-    {
-      listener_->lookupTransform("world",closest_camera_tf_name.str(),ros::Time(0),
-                                 world_position_transform_);
-    }
-    catch(tf::TransformException &ex)
-    {
-      ROS_ERROR("Not able to lookup transform");
-    }
+    // Several mapped markers visible - one solve over all their corners, closest marker pose is the initial guess
+    if((joint_pnp_ == true) && (num_of_visible_markers > 1))
+      solveCameraPoseJoint(camera, real_time_markers, camera_to_world);
+
+    camera.world_position_transform.setData(camera_to_world);
+    camera.world_position_transform.stamp_ = stamp;
 
     // Saving TF to Pose
-    const tf::Vector3 marker_origin = world_position_transform_.getOrigin();
-    world_position_geometry_msg_.position.x = marker_origin.getX();
-    world_position_geometry_msg_.position.y = marker_origin.getY();
-    world_position_geometry_msg_.position.z = marker_origin.getZ();
+    const tf::Vector3 marker_origin = camera.world_position_transform.getOrigin();
+    camera.world_position_geometry_msg.position.x = marker_origin.getX();
+    camera.world_position_geometry_msg.position.y = marker_origin.getY();
+    camera.world_position_geometry_msg.position.z = marker_origin.getZ();
+
+    tf::Quaternion marker_quaternion = camera.world_position_transform.getRotation();
+    camera.world_position_geometry_msg.orientation.x = marker_quaternion.getX();
+    camera.world_position_geometry_msg.orientation.y = marker_quaternion.getY();
+    camera.world_position_geometry_msg.orientation.z = marker_quaternion.getZ();
+    camera.world_position_geometry_msg.orientation.w = marker_quaternion.getW();
+  }
+}
+/////////////////////////////////////////////////////////////
+bool
+ArucoTracking::solveCameraPoseJoint(CameraContext &camera, const std::vector<aruco::Marker> &real_time_markers,
+                                    tf::Transform &camera_to_world)
+{
+  joint_object_points_.clear();
+  joint_image_points_.clear();
 
-    tf::Quaternion marker_quaternion = world_position_transform_.getRotation();
-    world_position_geometry_msg_.orientation.x = marker_quaternion.getX();
-    world_position_geometry_msg_.orientation.y = marker_quaternion.getY();
-    world_position_geometry_msg_.orientation.z = marker_quaternion.getZ();
-    world_position_geometry_msg_.orientation.w = marker_quaternion.getW();
+  for(size_t i = 0; i < real_time_markers.size(); i++)
+  {
+    const aruco::Marker &marker = real_time_markers[i];
+    if((markers_.previous(marker.id) == -1) || (marker.size() != 4))
+      continue;
+    const tf::Transform marker_to_world = markers_.toWorld(marker.id).toTf();
+    const double half_size = marker_sizes_[marker.id] / 2.0;
+
+    // Aruco corner order (-h,-h) (-h,h) (h,h) (h,-h), in ROS marker frame point (x,y,0) becomes (-x,0,y)
+    const double corner_x[4] = {-half_size, -half_size, half_size, half_size};
+    const double corner_y[4] = {-half_size, half_size, half_size, -half_size};
+    for(int k = 0; k < 4; k++)
+    {
+      const tf::Vector3 corner = marker_to_world * tf::Vector3(-corner_x[k], 0, corner_y[k]);
+      joint_object_points_.push_back(cv::Point3f(corner.getX(), corner.getY(), corner.getZ()));
+      joint_image_points_.push_back(marker[k]);
+    }
   }
+
+  if(joint_object_points_.size() < 8)
+    return false;
+
+  // Initial guess - world pose w.r.t. the camera
+  const tf::Transform world_to_camera = camera_to_world.inverse();
+  const tf::Matrix3x3 guess_rotation = world_to_camera.getBasis();
+  const tf::Vector3 guess_translation = world_to_camera.getOrigin();
+  joint_rotation_.create(3, 3, CV_64F);
+  for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 3; c++)
+      joint_rotation_.at<double>(r, c) = guess_rotation[r][c];
+  cv::Rodrigues(joint_rotation_, joint_rvec_);
+  joint_tvec_.create(3, 1, CV_64F);
+  joint_tvec_.at<double>(0,0) = guess_translation.getX();
+  joint_tvec_.at<double>(1,0) = guess_translation.getY();
+  joint_tvec_.at<double>(2,0) = guess_translation.getZ();
+
+  if(!cv::solvePnP(joint_object_points_, joint_image_points_, camera.pose_params.CameraMatrix,
+                   camera.pose_params.Distorsion, joint_rvec_, joint_tvec_, true))
+    return false;
+
+  cv::Rodrigues(joint_rvec_, joint_rotation_);
+  const tf::Matrix3x3 rotation(joint_rotation_.at<double>(0,0), joint_rotation_.at<double>(0,1), joint_rotation_.at<double>(0,2),
+                               joint_rotation_.at<double>(1,0), joint_rotation_.at<double>(1,1), joint_rotation_.at<double>(1,2),
+                               joint_rotation_.at<double>(2,0), joint_rotation_.at<double>(2,1), joint_rotation_.at<double>(2,2));
+  const tf::Vector3 translation(joint_tvec_.at<double>(0,0), joint_tvec_.at<double>(1,0), joint_tvec_.at<double>(2,0));
+
+  camera_to_world = tf::Transform(rotation, translation).inverse();
+  return true;
 }
 /////////////////////////////////////////////////////////////
 
 
 void
-ArucoTracking::nearestMarkersToCamera(bool &any_markers_visible, int &num_of_visible_markers)
+ArucoTracking::nearestMarkersToCamera(CameraContext &camera, bool &any_markers_visible, int &num_of_visible_markers)
 {
   if(first_marker_detected_ == true)
   {
     double minimal_distance = INIT_MIN_SIZE_VALUE;
-    for (std::map<int, MarkerInfo>::iterator it=markers_.begin(); it!=markers_.end(); ++it)
+    const std::vector<int> &ids = markers_.ids();
+    for (size_t i = 0; i < ids.size(); i++)
     {
-      int k = it->first;
+      int k = ids[i];
       double a,b,c,size;;
-      // If marker is visible, distance is calculated
-      if(markers_[k].visible==true)
+      // If marker is visible and placed in world, distance is calculated
+      if((markers_.visible(k)==true) && (markers_.previous(k) != -1))
       {
-        a = markers_[k].current_camera_pose.position.x;
-        b = markers_[k].current_camera_pose.position.y;
-        c = markers_[k].current_camera_pose.position.z;
+        a = camera.marker_camera_poses[k].position[0];
+        b = camera.marker_camera_poses[k].position[1];
+        c = camera.marker_camera_poses[k].position[2];
         size = std::sqrt((a * a) + (b * b) + (c * c));
         if(size < minimal_distance)
         {
           minimal_distance = size;
-          closest_camera_index_ = k;
+          camera.closest_camera_index = k;
         }
 
         any_markers_visible = true;
@@ -487,41 +1977,63 @@ ArucoTracking::nearestMarkersToCamera(bool &any_markers_visible, int &num_of_vis
   }
 }
 
+aruco_tracking::ArucoMarkerPtr
+ArucoTracking::acquireMarkerMsg(CameraContext &camera)
+{
+  // Message not held by any subscriber anymore can be refilled, its vectors keep their capacity
+  for(size_t i = 0; i < camera.marker_msg_pool.size(); i++)
+  {
+    if(camera.marker_msg_pool[i] && camera.marker_msg_pool[i].unique())
+      return camera.marker_msg_pool[i];
+  }
+
+  // All messages still held by subscribers, replace the oldest slot
+  aruco_tracking::ArucoMarkerPtr marker_msg = newMarkerMsg();
+  camera.marker_msg_pool[camera.marker_msg_pool_slot] = marker_msg;
+  camera.marker_msg_pool_slot = (camera.marker_msg_pool_slot + 1) % camera.marker_msg_pool.size();
+  return marker_msg;
+}
+
+aruco_tracking::ArucoMarkerPtr
+ArucoTracking::newMarkerMsg()
+{
+  aruco_tracking::ArucoMarkerPtr marker_msg = boost::make_shared<aruco_tracking::ArucoMarker>();
+  marker_msg->marker_ids.reserve(num_of_markers_);
+  marker_msg->global_marker_poses.reserve(num_of_markers_);
+  return marker_msg;
+}
+
 void
-ArucoTracking::publishCustomMarker(bool any_markers_visible, int num_of_visible_markers)
+ArucoTracking::prepareCustomMarker(CameraContext &camera, Frame &frame, bool any_markers_visible, int num_of_visible_markers)
 {
-  aruco_tracking::ArucoMarker marker_msg;
+  // Published as shared pointer, so subscribers in the same nodelet manager get it without copy
+  frame.marker_msg = acquireMarkerMsg(camera);
+  aruco_tracking::ArucoMarker *marker_msg = frame.marker_msg.get();
+  marker_msg->header.stamp = frame.header.stamp;
+  marker_msg->header.frame_id = "world";
+  marker_msg->num_of_visible_markers = num_of_visible_markers;
+  marker_msg->marker_ids.clear();
+  marker_msg->global_marker_poses.clear();
+
   if((any_markers_visible == true))
   {
-    marker_msg.header.stamp = ros::Time::now();
-    marker_msg.header.frame_id = "world";
-    marker_msg.marker_visibile = true;
-    marker_msg.num_of_visible_markers = num_of_visible_markers;
-    marker_msg.global_camera_pose = world_position_geometry_msg_;
-    marker_msg.marker_ids.clear();
-    marker_msg.global_marker_poses.clear();
-    for (std::map<int, MarkerInfo>::iterator it=markers_.begin(); it!=markers_.end(); ++it)
-    {
-      int j =it->first;
-      if(markers_[j].visible == true)
+    marker_msg->marker_visibile = true;
+    marker_msg->global_camera_pose = camera.world_position_geometry_msg;
+    const std::vector<int> &ids = markers_.ids();
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      if(markers_.visible(ids[i]) == true)
       {
-        marker_msg.marker_ids.push_back(markers_[j].marker_id);
-        marker_msg.global_marker_poses.push_back(markers_[j].geometry_msg_to_world);
+        marker_msg->marker_ids.push_back(ids[i]);
+        marker_msg->global_marker_poses.push_back(geometry_msgs::Pose());
+        markers_.toWorld(ids[i]).toMsg(marker_msg->global_marker_poses.back());
       }
     }
   }
   else
   {
-    marker_msg.header.stamp = ros::Time::now();
-    marker_msg.header.frame_id = "world";
-    marker_msg.num_of_visible_markers = num_of_visible_markers;
-    marker_msg.marker_visibile = false;
-    marker_msg.marker_ids.clear();
-    marker_msg.global_marker_poses.clear();
+    marker_msg->marker_visibile = false;
   }
-
-  // Publish custom marker msg
-  marker_msg_pub_.publish(marker_msg);
 }
 
 void
@@ -534,86 +2046,39 @@ ArucoTracking::detectFirstMarker(std::vector<aruco::Marker> &real_time_markers)
       lowest_marker_id_ = real_time_markers[i].id;
   }
   ROS_DEBUG_STREAM("The lowest Id marker " << lowest_marker_id_ );
-  MarkerInfo marker;
-   // Identify lowest marker ID with world's origin
-  marker.marker_id = lowest_marker_id_;
-
-  marker.geometry_msg_to_world.position.x = 0;
-  marker.geometry_msg_to_world.position.y = 0;
-  marker.geometry_msg_to_world.position.z = 0;
-
-  marker.geometry_msg_to_world.orientation.x = 0;
-  marker.geometry_msg_to_world.orientation.y = 0;
-  marker.geometry_msg_to_world.orientation.z = 0;
-  marker.geometry_msg_to_world.orientation.w = 1;
-
-   // Relative position and Global position
-  marker.geometry_msg_to_previous.position.x = 0;
-  marker.geometry_msg_to_previous.position.y = 0;
-  marker.geometry_msg_to_previous.position.z = 0;
-
-  marker.geometry_msg_to_previous.orientation.x = 0;
-  marker.geometry_msg_to_previous.orientation.y = 0;
-  marker.geometry_msg_to_previous.orientation.z = 0;
-  marker.geometry_msg_to_previous.orientation.w = 1;
-
-   // Transformation Pose to TF
-  tf::Vector3 position;
-  position.setX(0);
-  position.setY(0);
-  position.setZ(0);
-
-  tf::Quaternion rotation;
-  rotation.setX(0);
-  rotation.setY(0);
-  rotation.setZ(0);
-  rotation.setW(1);
-
-  marker.tf_to_previous.setOrigin(position);
-  marker.tf_to_previous.setRotation(rotation);
-
-   // Relative position of first marker equals Global position
-  marker.tf_to_world=marker.tf_to_previous;
 
+  // Identify lowest marker ID with world's origin, relative position of first marker equals global position
+  markers_.add(lowest_marker_id_);
+  markers_.toPrevious(lowest_marker_id_) = CompactPose();
+  markers_.toWorld(lowest_marker_id_) = CompactPose();
 
    // Set sign of visibility of first marker
-  marker.visible=true;
+  markers_.setVisible(lowest_marker_id_, true);
    //First marker does not have any previous marker
-  marker.previous_marker_id = THIS_IS_FIRST_MARKER;
-  markers_[lowest_marker_id_] = marker;
-  ROS_INFO_STREAM("First marker with ID: " << markers_[lowest_marker_id_].marker_id << " detected");
+  markers_.setPrevious(lowest_marker_id_, THIS_IS_FIRST_MARKER);
+  ROS_INFO_STREAM("First marker with ID: " << lowest_marker_id_ << " detected");
 }
 /////////////////////////////////////////////////////////////////////////////
 
 
 void
-ArucoTracking::setCurrentCameraPose(aruco::Marker &real_time_marker, int current_marker_id, bool inverse)
+ArucoTracking::setCurrentCameraPose(CameraContext &camera, aruco::Marker &real_time_marker, int current_marker_id, bool inverse)
 {
   if (first_marker_detected_ == true && real_time_marker.id == current_marker_id)
   {
-    markers_[current_marker_id].current_camera_tf = arucoMarker2Tf(real_time_marker);
-    setCameraPose(current_marker_id, inverse);
+    setCameraPose(camera, current_marker_id, arucoMarker2Tf(real_time_marker), inverse);
   }
 }
 /////////////////////////////////////////////
 void
-ArucoTracking::setCameraPose(int current_marker_id, bool inverse)
+ArucoTracking::setCameraPose(CameraContext &camera, int current_marker_id, const tf::Transform &marker_to_camera, bool inverse)
 {
-  // Invert and position of marker to compute camera pose above it
+  // Invert and position of marker to compute camera pose above it, every camera keeps its own
   if(inverse)
-  {
-    markers_[current_marker_id].current_camera_tf = markers_[current_marker_id].current_camera_tf.inverse();
-  }
-  const tf::Vector3 marker_origin = markers_[current_marker_id].current_camera_tf.getOrigin();
-  markers_[current_marker_id].current_camera_pose.position.x = marker_origin.getX();
-  markers_[current_marker_id].current_camera_pose.position.y = marker_origin.getY();
-  markers_[current_marker_id].current_camera_pose.position.z = marker_origin.getZ();
-
-  const tf::Quaternion marker_quaternion = markers_[current_marker_id].current_camera_tf.getRotation();
-  markers_[current_marker_id].current_camera_pose.orientation.x = marker_quaternion.getX();
-  markers_[current_marker_id].current_camera_pose.orientation.y = marker_quaternion.getY();
-  markers_[current_marker_id].current_camera_pose.orientation.z = marker_quaternion.getZ();
-  markers_[current_marker_id].current_camera_pose.orientation.w = marker_quaternion.getW();
+    camera.marker_camera_poses[current_marker_id].fromTf(marker_to_camera.inverse());
+  else
+    camera.marker_camera_poses[current_marker_id].fromTf(marker_to_camera);
+  camera.marker_camera_known[current_marker_id] = true;
 }
 
 void
@@ -621,11 +2086,13 @@ ArucoTracking::markVisible(std::vector<aruco::Marker> &real_time_markers)
 {
   //This function marks the previously detected markers visible i.e, whether already detected markers
   // are in the current image or not.
+  const ros::Time now = ros::Time::now();
   for(size_t k = 0;k < real_time_markers.size(); k++)
   {
-    if (markers_.count(real_time_markers[k].id)> 0)
+    if (markers_.contains(real_time_markers[k].id))
     {
-       markers_[real_time_markers[k].id].visible = true;
+       markers_.setVisible(real_time_markers[k].id, true);
+       markers_.setLastSeen(real_time_markers[k].id, now);
     }
   }
 }
@@ -634,85 +2101,201 @@ ArucoTracking::markVisible(std::vector<aruco::Marker> &real_time_markers)
 bool
 ArucoTracking::isDetected(int marker_id)
 {
-  return markers_.count(marker_id) > 0;
+  return markers_.contains(marker_id);
 }
 //////////////////////////////////////////////
 
 void
-ArucoTracking::publishTfs(bool world_option)
+ArucoTracking::collectTfs(CameraContext &camera, Frame &frame, bool world_option)
 {
-  for(std::map<int, MarkerInfo>::iterator it=markers_.begin(); it!=markers_.end(); ++it)
+  static const std::string world_frame("world");
+  const ros::Time &stamp = frame.header.stamp;
+  const std::vector<int> &ids = markers_.ids();
+  size_t count = 0;
+  for(size_t k = 0; k < ids.size(); k++)
   {
-    int i = it->first;
-    // Actual Marker
-    std::stringstream marker_tf_id;
-    marker_tf_id << "marker_" << i;
+    int i = ids[k];
+
+    // Marker not chained to world has no parent frame
+    if(markers_.previous(i) == -1)
+      continue;
 
     // Older marker - or World
-    std::stringstream marker_tf_id_old;
-    if(i == lowest_marker_id_)
-      marker_tf_id_old << "world";
-    else
-      marker_tf_id_old << "marker_" << markers_[i].previous_marker_id;
-    broadcaster_.sendTransform(tf::StampedTransform(markers_[i].tf_to_previous, ros::Time::now() ,marker_tf_id_old.str(), marker_tf_id.str()));
+    const std::string &marker_tf_id_old = (i == lowest_marker_id_) ? world_frame : marker_frame_names_[markers_.previous(i)];
+    setTransform(frame.transforms, count, markers_.toPrevious(i).toTf(), stamp, marker_tf_id_old, marker_frame_names_[i]);
 
-    // Position of camera to its marker
-    std::stringstream camera_tf_id;
-    camera_tf_id << "camera_" << i;
-    broadcaster_.sendTransform(tf::StampedTransform(markers_[i].current_camera_tf,ros::Time::now(),marker_tf_id.str(),camera_tf_id.str()));
+    // Position of this camera to the marker, in namespace of the camera
+    if(camera.marker_camera_known[i])
+      setTransform(frame.transforms, count, camera.marker_camera_poses[i].toTf(), stamp, marker_frame_names_[i],
+                   camera.marker_camera_frames[i]);
 
+    // Global position of marker TF
     if(world_option == true)
-    {
-      // Global position of marker TF
-      std::stringstream marker_globe;
-      marker_globe << "marker_globe_" << i;
-      broadcaster_.sendTransform(tf::StampedTransform(markers_[i].tf_to_world,ros::Time::now(),"world",marker_globe.str()));
-    }
-
-    // Cubes for RVIZ - markers
-    publishMarker(markers_[i].geometry_msg_to_previous, markers_[i].marker_id);
+      setTransform(frame.transforms, count, markers_.toWorld(i).toTf(), stamp, world_frame, marker_globe_frame_names_[i]);
   }
 
   // Global Position of object
   if(world_option == true)
-    broadcaster_.sendTransform(tf::StampedTransform(world_position_transform_,ros::Time::now(),"world","camera_position"));
-}
+  {
+    setTransform(frame.transforms, count, frame.world_position_transform, stamp, world_frame, camera.camera_frame);
 
-////////////////////////////////////////////////////////////////////////////////////////////////
+    // Rig pose from camera pose and its extrinsics
+    if(multi_camera_ == true)
+      setTransform(frame.transforms, count, frame.world_position_transform * camera.extrinsics.inverse(),
+                   stamp, world_frame, camera.rig_frame);
+  }
+
+  // Shrinks only when less markers are known, elements kept are reused by the next frame
+  frame.transforms.resize(count);
+}
 
 void
-ArucoTracking::publishMarker(geometry_msgs::Pose marker_pose, int marker_id)
+ArucoTracking::visualizationTimerCallback(const ros::TimerEvent &event)
 {
-  visualization_msgs::Marker vis_marker;
+  // Nobody listens - nothing built, shown set starts empty for next subscriber
+  if(marker_visualization_pub_.getNumSubscribers() == 0)
+  {
+    vis_shown_ids_.clear();
+    return;
+  }
 
-  if(marker_id == lowest_marker_id_)
-    vis_marker.header.frame_id = "world";
-  else
+  const ros::Time now = ros::Time::now();
+  std::vector<visualization_msgs::Marker> &vis_markers = vis_markers_.markers;
+  vis_markers.clear();
+
+  std::lock_guard<std::mutex> lock(map_mutex_);
+
+  // Markers shown last time and not seen since are deleted
+  for(size_t i = 0; i < vis_shown_ids_.size(); i++)
+  {
+    const int id = vis_shown_ids_[i];
+    if((now - markers_.lastSeen(id)).toSec() <= RVIZ_MARKER_TIMEOUT)
+      continue;
+
+    vis_markers.push_back(visualization_msgs::Marker());
+    fillVisMarker(vis_markers.back(), id, now);
+    vis_markers.back().action = visualization_msgs::Marker::DELETE;
+  }
+
+  // Markers placed in world and seen recently are added or updated
+  vis_shown_ids_.clear();
+  const std::vector<int> &ids = markers_.ids();
+  for(size_t k = 0; k < ids.size(); k++)
   {
-    std::stringstream marker_tf_id_old;
-    marker_tf_id_old << "marker_" << markers_[marker_id].previous_marker_id;
-    vis_marker.header.frame_id = marker_tf_id_old.str();
+    const int id = ids[k];
+    if((markers_.previous(id) == -1) || ((now - markers_.lastSeen(id)).toSec() > RVIZ_MARKER_TIMEOUT))
+      continue;
+
+    vis_markers.push_back(visualization_msgs::Marker());
+    fillVisMarker(vis_markers.back(), id, now);
+    vis_shown_ids_.push_back(id);
   }
 
-  vis_marker.header.stamp = ros::Time::now();
+  if(!vis_markers.empty())
+    marker_visualization_pub_.publish(vis_markers_);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+void
+ArucoTracking::fillVisMarker(visualization_msgs::Marker &vis_marker, int marker_id, const ros::Time &stamp)
+{
+  // Pose with respect to world, so cubes do not depend on TF publish rate
+  vis_marker.header.frame_id = "world";
+  vis_marker.header.stamp = stamp;
   vis_marker.ns = "basic_shapes";
   vis_marker.id = marker_id;
   vis_marker.type = visualization_msgs::Marker::CUBE;
   vis_marker.action = visualization_msgs::Marker::ADD;
 
-  vis_marker.pose = marker_pose;
-  vis_marker.scale.x = marker_size_;
-  vis_marker.scale.y = marker_size_;
+  markers_.toWorld(marker_id).toMsg(vis_marker.pose);
+  vis_marker.scale.x = marker_sizes_[marker_id];
+  vis_marker.scale.y = marker_sizes_[marker_id];
   vis_marker.scale.z = RVIZ_MARKER_HEIGHT;
 
   vis_marker.color.r = RVIZ_MARKER_COLOR_R;
   vis_marker.color.g = RVIZ_MARKER_COLOR_G;
   vis_marker.color.b = RVIZ_MARKER_COLOR_B;
   vis_marker.color.a = RVIZ_MARKER_COLOR_A;
+}
+
+void
+ArucoTracking::metricsTimerCallback(const ros::TimerEvent &event)
+{
+  TrackerMetrics::Snapshot current;
+  metrics_.snapshot(current);
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  const double period = std::max(std::chrono::duration<double>(now - metrics_previous_time_).count(), 1e-6);
+
+  if(!metrics_file_.empty() && !TrackerMetrics::writePrometheus(metrics_file_, current))
+    ROS_WARN_STREAM_THROTTLE(10.0, "Not able to write metrics file " << metrics_file_);
+
+  // Activity since previous export
+  TrackerMetrics::Snapshot recent;
+  TrackerMetrics::difference(current, metrics_previous_, recent);
+  metrics_previous_ = current;
+  metrics_previous_time_ = now;
+
+  diagnostic_msgs::DiagnosticArrayPtr diagnostics(new diagnostic_msgs::DiagnosticArray);
+  diagnostics->header.stamp = ros::Time::now();
+  diagnostics->status.resize(1);
+  diagnostic_msgs::DiagnosticStatus &status = diagnostics->status[0];
+  status.name = ros::this_node::getName() + ": frame loop";
+  status.hardware_id = ros::this_node::getName();
+
+  diagnostic_msgs::KeyValue value;
+  for(int i = 0; i < TrackerMetrics::NUM_OF_COUNTERS; i++)
+  {
+    const TrackerMetrics::Counter counter = TrackerMetrics::Counter(i);
+    value.key = TrackerMetrics::counterName(counter);
+    value.value = std::to_string(current.counters[i]);
+    status.values.push_back(value);
+    value.key = std::string(TrackerMetrics::counterName(counter)) + " per s";
+    value.value = std::to_string(recent.counters[i] / period);
+    status.values.push_back(value);
+  }
+
+  // Stage with the highest mean latency is the one to blame when frames are dropped
+  int slowest_stage = -1;
+  double slowest_mean = 0;
+  for(int i = 0; i < TrackerMetrics::NUM_OF_STAGES; i++)
+  {
+    const TrackerMetrics::Stage stage = TrackerMetrics::Stage(i);
+    const TrackerMetrics::Histogram &histogram = recent.stages[i];
+    const double mean = (histogram.count > 0) ? histogram.sum / histogram.count : 0;
+    value.key = std::string(TrackerMetrics::stageName(stage)) + " mean ms";
+    value.value = std::to_string(1000 * mean);
+    status.values.push_back(value);
+    value.key = std::string(TrackerMetrics::stageName(stage)) + " p99 ms";
+    value.value = std::to_string(1000 * TrackerMetrics::percentile(histogram, 0.99));
+    status.values.push_back(value);
+
+    if((stage != TrackerMetrics::STAGE_TF_SEND) && (mean > slowest_mean))
+    {
+      slowest_stage = i;
+      slowest_mean = mean;
+    }
+  }
 
-  vis_marker.lifetime = ros::Duration(RVIZ_MARKER_LIFETIME);
+  const char *slowest_name = (slowest_stage >= 0) ? TrackerMetrics::stageName(TrackerMetrics::Stage(slowest_stage)) : "none";
+  if(recent.counters[TrackerMetrics::FRAMES_DROPPED] > 0)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Falling behind, " + std::to_string(recent.counters[TrackerMetrics::FRAMES_DROPPED]) +
+                     " frames dropped, slowest stage " + slowest_name;
+  }
+  else if(recent.counters[TrackerMetrics::FRAMES_RECEIVED] == 0)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "No images received";
+  }
+  else
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = std::string("Keeping up, slowest stage ") + slowest_name;
+  }
 
-  marker_visualization_pub_.publish(vis_marker);
+  diagnostics_pub_.publish(diagnostics);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -720,22 +2303,12 @@ ArucoTracking::publishMarker(geometry_msgs::Pose marker_pose, int marker_id)
 tf::Transform
 ArucoTracking::arucoMarker2Tf(const aruco::Marker &marker)
 {
-  cv::Mat marker_rotation(3,3, CV_32FC1);
-  cv::Rodrigues(marker.Rvec, marker_rotation);
-  cv::Mat marker_translation = marker.Tvec;
-
-  cv::Mat rotate_to_ros(3,3,CV_32FC1);
-  rotate_to_ros.at<float>(0,0) = -1.0;
-  rotate_to_ros.at<float>(0,1) = 0;
-  rotate_to_ros.at<float>(0,2) = 0;
-  rotate_to_ros.at<float>(1,0) = 0;
-  rotate_to_ros.at<float>(1,1) = 0;
-  rotate_to_ros.at<float>(1,2) = 1.0;
-  rotate_to_ros.at<float>(2,0) = 0.0;
-  rotate_to_ros.at<float>(2,1) = 1.0;
-  rotate_to_ros.at<float>(2,2) = 0.0;
-
-  marker_rotation = marker_rotation * rotate_to_ros;//.t();
+  // Scratch matrices are members, Rodrigues and gemm reuse their buffers
+  cv::Rodrigues(marker.Rvec, marker_rotation_);
+  cv::gemm(marker_rotation_, rotate_to_ros_, 1.0, cv::noArray(), 0.0, marker_rotation_ros_);
+
+  const cv::Mat &marker_rotation = marker_rotation_ros_;
+  const cv::Mat &marker_translation = marker.Tvec;
 
   // Origin solution
   tf::Matrix3x3 marker_tf_rot(marker_rotation.at<float>(0,0),marker_rotation.at<float>(0,1),marker_rotation.at<float>(0,2),
@@ -0,0 +1,375 @@
+/*********************************************************************************************//**
+* @file aruco_tracking_benchmark.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#include <camera_calibration_parsers/parse_ini.h>
+#include <aruco_tracking.h>
+#include <synthetic_scene.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+/** \brief Offline replay of recorded or synthetic images through the tracker at full speed.
+ *         Needs only a running master for parameters, no other node.
+ *
+ *  aruco_tracking_benchmark (--images <dir> | --bag <file> [--topic <topic>] | --synthetic <frames>)
+ *                           [--repeat <n>] [--output <file.json>]
+ *
+ *  Synthetic scene options: --noise <gray levels> --blur <px> --distance_scale <factor>
+ *                           --max_translation_error <m> --max_rotation_error <deg>
+ *
+ *  Tracker parameters are read from the private namespace as for the node, headless is forced.
+ *  Synthetic scenes are rendered with calibration_file and marker_size of the tracker. If an error
+ *  limit is given and exceeded, or markers are lost, exit code is nonzero. */
+
+namespace
+{
+
+struct StageSamples
+{
+  std::vector<double> convert;
+  std::vector<double> detect;
+  std::vector<double> map;
+  std::vector<double> pose;
+  std::vector<double> publish;
+  std::vector<double> total;
+  std::vector<double> translation_error;
+  std::vector<double> rotation_error;
+  size_t frames_without_pose = 0;
+};
+
+std::mutex samples_mutex;
+StageSamples samples;
+std::atomic<size_t> frames_done(0);
+
+/** \brief Ground truth camera pose of every synthetic frame, replayed in order */
+std::vector<tf::Transform> ground_truth;
+
+const int STALL_TIMEOUT = 5;
+
+void
+frameTimingCallback(int camera_index, const std_msgs::Header &header,
+                    const aruco_tracking::ArucoTracking::FrameTiming &timing,
+                    const aruco_tracking::ArucoMarkerConstPtr &marker_msg)
+{
+  std::lock_guard<std::mutex> lock(samples_mutex);
+  samples.convert.push_back(timing.convert);
+  samples.detect.push_back(timing.detect);
+  samples.map.push_back(timing.map);
+  samples.pose.push_back(timing.pose);
+  samples.publish.push_back(timing.publish);
+  samples.total.push_back(timing.convert + timing.detect + timing.map + timing.pose + timing.publish);
+
+  // Synthetic frames carry their index in header, frames which failed conversion never arrive
+  if(!ground_truth.empty())
+  {
+    if(marker_msg && marker_msg->marker_visibile)
+    {
+      tf::Transform estimate;
+      tf::poseMsgToTF(marker_msg->global_camera_pose, estimate);
+      const tf::Transform &truth = ground_truth[header.seq % ground_truth.size()];
+      samples.translation_error.push_back((estimate.getOrigin() - truth.getOrigin()).length());
+      samples.rotation_error.push_back(estimate.getRotation().angleShortestPath(truth.getRotation()) * 180 / M_PI);
+    }
+    else
+      samples.frames_without_pose++;
+  }
+  frames_done++;
+}
+
+/** \brief Percentile of sorted samples, nearest rank */
+double
+percentile(const std::vector<double> &sorted, double p)
+{
+  if(sorted.empty())
+    return 0;
+  size_t rank = size_t(p * sorted.size() + 0.5);
+  rank = std::min(std::max(rank, size_t(1)), sorted.size());
+  return sorted[rank - 1];
+}
+
+/** \brief One JSON object with mean, p50, p99 and max of samples */
+double
+writeStatistics(std::ostream &out, const std::string &name, std::vector<double> values, double scale,
+                const std::string &unit, bool last)
+{
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for(size_t i = 0; i < values.size(); i++)
+    sum += values[i];
+  const double max = values.empty() ? 0 : values.back();
+
+  out << "    \"" << name << "\": {"
+      << "\"mean_" << unit << "\": " << (values.empty() ? 0 : scale * sum / values.size())
+      << ", \"p50_" << unit << "\": " << scale * percentile(values, 0.50)
+      << ", \"p99_" << unit << "\": " << scale * percentile(values, 0.99)
+      << ", \"max_" << unit << "\": " << scale * max
+      << "}" << (last ? "" : ",") << "\n";
+  return max;
+}
+
+bool
+loadImages(const std::string &directory, std::vector<sensor_msgs::ImageConstPtr> &images)
+{
+  std::vector<cv::String> filenames;
+  cv::glob(directory + "/*", filenames, false);
+  std::sort(filenames.begin(), filenames.end());
+
+  for(size_t i = 0; i < filenames.size(); i++)
+  {
+    cv::Mat image = cv::imread(filenames[i], cv::IMREAD_GRAYSCALE);
+    if(image.empty())
+      continue;
+
+    std_msgs::Header header;
+    header.seq = images.size();
+    header.frame_id = "camera";
+    images.push_back(cv_bridge::CvImage(header, sensor_msgs::image_encodings::MONO8, image).toImageMsg());
+  }
+  return !images.empty();
+}
+
+bool
+loadBag(const std::string &filename, const std::string &topic, std::vector<sensor_msgs::ImageConstPtr> &images)
+{
+  try
+  {
+    rosbag::Bag bag(filename, rosbag::bagmode::Read);
+    rosbag::View view(bag, rosbag::TopicQuery(std::vector<std::string>(1, topic)));
+    for(rosbag::View::iterator it = view.begin(); it != view.end(); ++it)
+    {
+      sensor_msgs::ImageConstPtr image = it->instantiate<sensor_msgs::Image>();
+      if(image)
+        images.push_back(image);
+    }
+  }
+  catch(rosbag::BagException &e)
+  {
+    ROS_ERROR_STREAM("Not able to read bag " << filename << ": " << e.what());
+    return false;
+  }
+  return !images.empty();
+}
+
+bool
+renderSynthetic(ros::NodeHandle &private_nh, int num_of_frames, const aruco_tracking::SyntheticScene::Options &options,
+                std::vector<sensor_msgs::ImageConstPtr> &images)
+{
+  std::string calib_filename;
+  private_nh.param<std::string>("calibration_file", calib_filename, "");
+
+  sensor_msgs::CameraInfo camera_info;
+  std::string camera_name;
+  if(!camera_calibration_parsers::readCalibrationIni(calib_filename, camera_name, camera_info))
+  {
+    ROS_ERROR_STREAM("Not able to read calibration " << calib_filename);
+    return false;
+  }
+
+  cv::Mat camera_matrix(3, 3, CV_64F), distortion = cv::Mat::zeros(1, 5, CV_64F);
+  for(int i = 0; i < 9; i++)
+    camera_matrix.at<double>(i / 3, i % 3) = camera_info.K[i];
+  for(size_t i = 0; i < std::min(camera_info.D.size(), size_t(5)); i++)
+    distortion.at<double>(0, i) = camera_info.D[i];
+
+  aruco_tracking::SyntheticScene scene(camera_matrix, distortion, cv::Size(camera_info.width, camera_info.height), options);
+
+  std_msgs::Header header;
+  header.frame_id = "camera";
+  cv::Mat image;
+  for(int i = 0; i < num_of_frames; i++)
+  {
+    tf::Transform truth;
+    scene.render(i, num_of_frames, image, truth);
+    ground_truth.push_back(truth);
+
+    header.seq = i;
+    images.push_back(cv_bridge::CvImage(header, sensor_msgs::image_encodings::MONO8, image.clone()).toImageMsg());
+  }
+  return true;
+}
+
+}  // namespace
+
+int
+main(int argc, char **argv)
+{
+  ros::init(argc, argv, "aruco_tracking_benchmark", ros::init_options::AnonymousName);
+
+  std::string images_dir, bag_file, topic = "/image_raw", output_file;
+  int repeat = 1, synthetic_frames = 0;
+  double max_translation_error = -1, max_rotation_error = -1;
+  aruco_tracking::SyntheticScene::Options options;
+  for(int i = 1; i + 1 < argc; i += 2)
+  {
+    if(std::strcmp(argv[i], "--images") == 0)
+      images_dir = argv[i + 1];
+    else if(std::strcmp(argv[i], "--bag") == 0)
+      bag_file = argv[i + 1];
+    else if(std::strcmp(argv[i], "--topic") == 0)
+      topic = argv[i + 1];
+    else if(std::strcmp(argv[i], "--synthetic") == 0)
+      synthetic_frames = std::atoi(argv[i + 1]);
+    else if(std::strcmp(argv[i], "--noise") == 0)
+      options.noise_sigma = std::atof(argv[i + 1]);
+    else if(std::strcmp(argv[i], "--blur") == 0)
+      options.blur_sigma = std::atof(argv[i + 1]);
+    else if(std::strcmp(argv[i], "--distance_scale") == 0)
+      options.distance_scale = std::atof(argv[i + 1]);
+    else if(std::strcmp(argv[i], "--max_translation_error") == 0)
+      max_translation_error = std::atof(argv[i + 1]);
+    else if(std::strcmp(argv[i], "--max_rotation_error") == 0)
+      max_rotation_error = std::atof(argv[i + 1]);
+    else if(std::strcmp(argv[i], "--repeat") == 0)
+      repeat = std::max(1, std::atoi(argv[i + 1]));
+    else if(std::strcmp(argv[i], "--output") == 0)
+      output_file = argv[i + 1];
+  }
+
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  //------------------------------------------------------
+  // Sequence held in memory, disk and rendering are not measured
+  //------------------------------------------------------
+  std::vector<sensor_msgs::ImageConstPtr> images;
+  bool loaded = false;
+  if(!images_dir.empty())
+    loaded = loadImages(images_dir, images);
+  else if(!bag_file.empty())
+    loaded = loadBag(bag_file, topic, images);
+  else if(synthetic_frames > 0)
+  {
+    private_nh.param("marker_size", options.marker_size, options.marker_size);
+    loaded = renderSynthetic(private_nh, synthetic_frames, options, images);
+  }
+
+  if(loaded == false)
+  {
+    std::cerr << "Usage: aruco_tracking_benchmark (--images <dir> | --bag <file> [--topic <topic>] | --synthetic <frames>)"
+              << " [--repeat <n>] [--output <file.json>]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // No window, and pipeline never drops frames so every image is measured
+  private_nh.setParam("headless", true);
+  private_nh.setParam("pipeline_drop_policy", std::string("block"));
+
+  // Ground truth starts from an empty map
+  if(!ground_truth.empty())
+    private_nh.setParam("map_file", std::string(""));
+
+  aruco_tracking::ArucoTracking tracker(&nh, &private_nh);
+  tracker.setFrameTimingCallback(&frameTimingCallback);
+
+  const size_t num_of_frames = images.size() * repeat;
+  samples.total.reserve(num_of_frames);
+
+  //------------------------------------------------------
+  // Replay at full speed
+  //------------------------------------------------------
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int r = 0; r < repeat; r++)
+    for(size_t i = 0; i < images.size(); i++)
+      tracker.imageCallback(images[i], 0);
+
+  // Pipeline mode finishes frames in its own threads, frames which failed conversion never arrive
+  size_t last_done = 0;
+  std::chrono::steady_clock::time_point last_progress = std::chrono::steady_clock::now();
+  while((frames_done < num_of_frames) && ros::ok())
+  {
+    if(frames_done != last_done)
+    {
+      last_done = frames_done;
+      last_progress = std::chrono::steady_clock::now();
+    }
+    else if(std::chrono::steady_clock::now() - last_progress > std::chrono::seconds(STALL_TIMEOUT))
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const double wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  //------------------------------------------------------
+  // Machine readable report
+  //------------------------------------------------------
+  std::ostringstream report;
+  std::lock_guard<std::mutex> lock(samples_mutex);
+  report << "{\n"
+         << "  \"frames\": " << samples.total.size() << ",\n"
+         << "  \"image_width\": " << images[0]->width << ",\n"
+         << "  \"image_height\": " << images[0]->height << ",\n"
+         << "  \"wall_time_s\": " << wall_time << ",\n"
+         << "  \"throughput_fps\": " << (wall_time > 0 ? samples.total.size() / wall_time : 0) << ",\n"
+         << "  \"stages\": {\n";
+  writeStatistics(report, "convert", samples.convert, 1000, "ms", false);
+  writeStatistics(report, "detect", samples.detect, 1000, "ms", false);
+  writeStatistics(report, "map", samples.map, 1000, "ms", false);
+  writeStatistics(report, "pose", samples.pose, 1000, "ms", false);
+  writeStatistics(report, "publish", samples.publish, 1000, "ms", false);
+  writeStatistics(report, "total", samples.total, 1000, "ms", true);
+  report << "  }";
+
+  // Accuracy against ground truth of synthetic scene
+  bool passed = true;
+  if(!ground_truth.empty())
+  {
+    report << ",\n  \"accuracy\": {\n"
+           << "    \"frames_without_pose\": " << samples.frames_without_pose << ",\n";
+    const double translation_error = writeStatistics(report, "translation_error", samples.translation_error, 1, "m", false);
+    const double rotation_error = writeStatistics(report, "rotation_error", samples.rotation_error, 1, "deg", true);
+    report << "  }";
+
+    passed = (samples.frames_without_pose == 0) && (samples.total.size() == num_of_frames) &&
+             ((max_translation_error < 0) || (translation_error <= max_translation_error)) &&
+             ((max_rotation_error < 0) || (rotation_error <= max_rotation_error));
+    report << ",\n  \"passed\": " << (passed ? "true" : "false");
+  }
+  report << "\n}\n";
+
+  std::cout << report.str();
+  if(!output_file.empty())
+  {
+    std::ofstream output(output_file.c_str());
+    output << report.str();
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,59 @@
+/*********************************************************************************************//**
+* @file aruco_tracking_nodelet.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <aruco_tracking.h>
+
+namespace aruco_tracking
+{
+
+/** \brief Nodelet wrapper of ArucoTracking, images from a camera nodelet in the same manager are not copied */
+class ArucoTrackingNodelet : public nodelet::Nodelet
+{
+private:
+
+  virtual void onInit()
+  {
+    // Multi-threaded handle, cameras are processed in parallel on the manager's worker threads
+    ros::NodeHandle &nh = getMTNodeHandle();
+    ros::NodeHandle &private_nh = getPrivateNodeHandle();
+
+    // Aruco mapping object, subscribes to images of all configured cameras
+    tracker_.reset(new ArucoTracking(&nh, &private_nh));
+  }
+
+  boost::shared_ptr<ArucoTracking> tracker_;
+
+}; //ArucoTrackingNodelet class
+}  //aruco_tracking namespace
+
+PLUGINLIB_EXPORT_CLASS(aruco_tracking::ArucoTrackingNodelet, nodelet::Nodelet)
@@ -0,0 +1,124 @@
+/*********************************************************************************************//**
+* @file frame_budget_governor.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <frame_budget_governor.h>
+
+#include <algorithm>
+
+namespace aruco_tracking
+{
+
+FrameBudgetGovernor::FrameBudgetGovernor() :
+  budget_ (0),                            // Disabled until configured
+  average_frame_time_ (0),                // No frame measured yet
+  level_ (0),                             // Configured settings
+  first_level_ (1),                       // Level stepped to from configured settings
+  frames_since_change_ (0)
+{
+}
+
+void
+FrameBudgetGovernor::configure(double budget, const DetectorTuning &base, bool dynamic_roi)
+{
+  budget_ = budget;
+  base_ = base;
+  average_frame_time_ = 0;
+  level_ = 0;
+  first_level_ = dynamic_roi ? 1 : FIRST_LEVEL_WITHOUT_ROI;
+  frames_since_change_ = 0;
+}
+
+bool
+FrameBudgetGovernor::update(double frame_time)
+{
+  if(budget_ <= 0)
+    return false;
+
+  // Exponential smoothing, first frame initializes the average
+  if(average_frame_time_ <= 0)
+    average_frame_time_ = frame_time;
+  else
+    average_frame_time_ += SMOOTHING * (frame_time - average_frame_time_);
+
+  frames_since_change_++;
+  if(frames_since_change_ < HOLD_FRAMES)
+    return false;
+
+  // Over budget - cheaper level, well under budget - back towards configured settings.
+  // Levels below first_level_ would not make anything cheaper
+  int level = level_;
+  if((average_frame_time_ > budget_) && (level_ < NUM_OF_LEVELS - 1))
+    level = std::max(level_ + 1, first_level_);
+  else if((average_frame_time_ < RELAX_RATIO * budget_) && (level_ > 0))
+    level = (level_ == first_level_) ? 0 : level_ - 1;
+
+  if(level == level_)
+    return false;
+
+  level_ = level;
+  frames_since_change_ = 0;
+  return true;
+}
+
+DetectorTuning
+FrameBudgetGovernor::tuning(int level) const
+{
+  // Steps ordered by expected loss of detection range, least harmful first
+  DetectorTuning tuning = base_;
+  if(level >= 1)
+    tuning.full_scan_period = base_.full_scan_period * 2;
+  if(level >= 2)
+    tuning.roi_margin = base_.roi_margin * 0.5;
+  if(level >= 3)
+    tuning.min_marker_size = base_.min_marker_size * 1.5f;
+  if(level >= 4)
+    tuning.pyramid_level_offset = 1;
+  if(level >= 5)
+    tuning.max_marker_size = std::max(base_.max_marker_size * 0.75f, 2 * tuning.min_marker_size);
+  if(level >= 6)
+  {
+    tuning.full_scan_period = base_.full_scan_period * 4;
+    tuning.min_marker_size = base_.min_marker_size * 2;
+  }
+  if(level >= 7)
+    tuning.pyramid_level_offset = 2;
+  return tuning;
+}
+
+int
+FrameBudgetGovernor::scaledBlockSize(int block_size, int pyramid_level_offset)
+{
+  // Same neighbourhood thresholded in downscaled image, odd as adaptive threshold requires
+  const int scaled = (block_size >> pyramid_level_offset) | 1;
+  return std::max(scaled, int(MIN_THRESHOLD_BLOCK_SIZE));
+}
+
+}  //aruco_tracking namespace
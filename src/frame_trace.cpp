@@ -0,0 +1,195 @@
+/*********************************************************************************************//**
+* @file frame_trace.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <frame_trace.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+
+namespace aruco_tracking
+{
+
+static const char *SPAN_NAMES[FrameTrace::NUM_OF_SPANS] =
+  {"receive", "convert", "detect", "marker_pose", "map", "pose", "publish"};
+
+/** \brief Span in bits 56-63, camera in 48-55, marker ID + 1 in 32-47, frame number in 0-31 */
+static inline uint64_t
+packInfo(int span, int camera, int marker_id, uint32_t frame)
+{
+  return (uint64_t(span & 0xff) << 56) | (uint64_t(camera & 0xff) << 48) |
+         (uint64_t((marker_id + 1) & 0xffff) << 32) | uint64_t(frame);
+}
+
+static inline uint64_t
+nanoseconds(FrameTrace::Clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+/** \brief Camera names are the only strings not known in advance */
+static void
+writeJsonString(FILE *file, const std::string &text)
+{
+  std::fputc('"', file);
+  for(size_t i = 0; i < text.size(); i++)
+  {
+    const unsigned char c = text[i];
+    if((c == '"') || (c == '\\'))
+      std::fprintf(file, "\\%c", c);
+    else if(c < 0x20)
+      std::fprintf(file, "\\u%04x", c);
+    else
+      std::fputc(c, file);
+  }
+  std::fputc('"', file);
+}
+
+/** \brief Dump requests by signal, lock-free atomic is safe to change in a signal handler */
+static std::atomic<int> dump_requests(0);
+
+static void
+dumpSignalHandler(int)
+{
+  dump_requests.fetch_add(1);
+}
+
+FrameTrace::ThreadRing::ThreadRing(size_t capacity) :
+  claimed(0),
+  written(0),
+  slots(new Slot[capacity])
+{
+}
+
+FrameTrace::FrameTrace() :
+  capacity_(0)
+{
+}
+
+void
+FrameTrace::configure(size_t capacity)
+{
+  capacity_ = capacity;
+}
+
+void
+FrameTrace::record(Span span, int camera, uint32_t frame, Clock::time_point start, Clock::time_point end,
+                   int marker_id)
+{
+  if(capacity_ == 0)
+    return;
+
+  ThreadRing &ring = rings_.local(capacity_);
+  const uint64_t index = ring.written.load(std::memory_order_relaxed);
+  Slot &slot = ring.slots[index % capacity_];
+
+  ring.claimed.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.start_ns.store(nanoseconds(start), std::memory_order_relaxed);
+  slot.duration_ns.store(end > start ? nanoseconds(end) - nanoseconds(start) : 0, std::memory_order_relaxed);
+  slot.info.store(packInfo(span, camera, marker_id, frame), std::memory_order_relaxed);
+  ring.written.store(index + 1, std::memory_order_release);
+}
+
+bool
+FrameTrace::writeChromeTrace(const std::string &filename, const std::vector<std::string> &camera_names)
+{
+  return writeFileAtomically(filename, [this, &camera_names](FILE *file)
+  {
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for(size_t i = 0; i < camera_names.size(); i++)
+    {
+      std::fprintf(file, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":",
+                   i == 0 ? "" : ",", int(i));
+      writeJsonString(file, camera_names[i].empty() ? std::string("camera") : camera_names[i]);
+      std::fprintf(file, "}}");
+    }
+
+    bool first = camera_names.empty();
+    std::vector<uint64_t> spans;
+    rings_.forEach([this, file, &first, &spans](size_t t, ThreadRing &ring)
+    {
+      // Copy the ring, then drop spans overwritten meanwhile by its thread
+      const uint64_t end = ring.written.load(std::memory_order_acquire);
+      const uint64_t begin = (end > capacity_) ? end - capacity_ : 0;
+      spans.clear();
+      for(uint64_t index = begin; index < end; index++)
+      {
+        const Slot &slot = ring.slots[index % capacity_];
+        spans.push_back(slot.start_ns.load(std::memory_order_relaxed));
+        spans.push_back(slot.duration_ns.load(std::memory_order_relaxed));
+        spans.push_back(slot.info.load(std::memory_order_relaxed));
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint64_t claimed = ring.claimed.load(std::memory_order_relaxed);
+      const uint64_t valid_begin = (claimed > capacity_) ? std::max(claimed - capacity_, begin) : begin;
+
+      for(uint64_t index = valid_begin; index < end; index++)
+      {
+        const uint64_t *span = &spans[3 * (index - begin)];
+        const int name = int(span[2] >> 56);
+        const int camera = int((span[2] >> 48) & 0xff);
+        const int marker_id = int((span[2] >> 32) & 0xffff) - 1;
+        const uint32_t frame = uint32_t(span[2]);
+
+        std::fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                     "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u",
+                     first ? "" : ",", SPAN_NAMES[name], camera, int(t), span[0] * 1e-3, span[1] * 1e-3, frame);
+        if(marker_id >= 0)
+          std::fprintf(file, ",\"marker_id\":%d", marker_id);
+        std::fprintf(file, "}}");
+        first = false;
+      }
+    });
+    std::fprintf(file, "\n]}\n");
+    return true;
+  });
+}
+
+const char *
+FrameTrace::spanName(Span span)
+{
+  return SPAN_NAMES[span];
+}
+
+void
+FrameTrace::installDumpSignal(int signal_number)
+{
+  std::signal(signal_number, dumpSignalHandler);
+}
+
+int
+FrameTrace::dumpRequests()
+{
+  return dump_requests.load();
+}
+
+}  //aruco_tracking namespace
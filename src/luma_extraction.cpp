@@ -0,0 +1,131 @@
+/*********************************************************************************************//**
+* @file luma_extraction.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <luma_extraction.h>
+
+#include <sensor_msgs/image_encodings.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace aruco_tracking
+{
+
+/** \brief YUYV byte order, constant is missing in image_encodings of older ROS releases */
+static const char YUV422_YUY2[] = "yuv422_yuy2";
+
+void
+extractEvenBytes(const uint8_t *src, uint8_t *dst, int n)
+{
+  int i = 0;
+
+  // 16 output bytes from 32 input bytes, vectors never read past the last needed byte
+#if defined(__SSE2__)
+  const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+  for(; i + 16 < n; i += 16)
+  {
+    const __m128i first = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i)), low_bytes);
+    const __m128i second = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 16)), low_bytes);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(first, second));
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for(; i + 16 < n; i += 16)
+    vst1q_u8(dst + i, vld2q_u8(src + 2 * i).val[0]);
+#endif
+
+  for(; i < n; i++)
+    dst[i] = src[2 * i];
+}
+
+bool
+extractLuma(const sensor_msgs::Image &image, const cv::Rect &roi, cv::Mat &gray)
+{
+  namespace enc = sensor_msgs::image_encodings;
+
+  if((roi & cv::Rect(0, 0, image.width, image.height)) != roi || roi.area() == 0)
+    return false;
+
+  // Packed 4:2:2 has luminance in every second byte, color is converted
+  const bool uyvy = (image.encoding == enc::YUV422);
+  const bool packed = uyvy || (image.encoding == YUV422_YUY2);
+  int code = -1, type = CV_8UC3, bytes_per_pixel = 3;
+  if(packed)
+    bytes_per_pixel = 2;
+  else if(image.encoding == enc::BGR8)
+    code = cv::COLOR_BGR2GRAY;
+  else if(image.encoding == enc::RGB8)
+    code = cv::COLOR_RGB2GRAY;
+  else if(image.encoding == enc::BGRA8)
+  {
+    code = cv::COLOR_BGRA2GRAY;
+    type = CV_8UC4;
+    bytes_per_pixel = 4;
+  }
+  else if(image.encoding == enc::RGBA8)
+  {
+    code = cv::COLOR_RGBA2GRAY;
+    type = CV_8UC4;
+    bytes_per_pixel = 4;
+  }
+  else
+    return false;
+
+  // Header fields come from the sender, rows must fit into step and all rows into data
+  if((size_t(image.step) < size_t(image.width) * bytes_per_pixel) ||
+     (size_t(image.step) * image.height > image.data.size()))
+    return false;
+
+  //------------------------------------------------------
+  // Packed 4:2:2, luminance is every second byte
+  //------------------------------------------------------
+  if(packed)
+  {
+    gray.create(roi.size(), CV_8UC1);
+    const int first_byte = 2 * roi.x + (uyvy ? 1 : 0);
+    for(int y = 0; y < roi.height; y++)
+      extractEvenBytes(&image.data[(roi.y + y) * image.step + first_byte], gray.ptr<uint8_t>(y), roi.width);
+    return true;
+  }
+
+  //------------------------------------------------------
+  // Color, only ROI is converted
+  //------------------------------------------------------
+  // Header only, received data is read in place
+  const cv::Mat color(image.height, image.width, type, const_cast<uint8_t *>(image.data.data()), image.step);
+  cv::cvtColor(color(roi), gray, code);
+  return true;
+}
+
+}  //aruco_tracking namespace
@@ -40,15 +40,18 @@ main(int argc, char **argv)
 {
   ros::init(argc,argv,"aruco_tracking");
   ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
       
-  // Aruco mapping object
-  aruco_tracking::ArucoTracking obj(&nh);
+  // Aruco mapping object, subscribes to images of all configured cameras
+  aruco_tracking::ArucoTracking obj(&nh, &private_nh);
 
-  // Image node and subscriber
-  image_transport::ImageTransport it(nh);
-  image_transport::Subscriber img_sub = it.subscribe("/image_raw", 1, &aruco_tracking::ArucoTracking::imageCallback, &obj);
+  // Worker pool processing cameras in parallel, 0 means one thread per core
+  int num_worker_threads = 0;
+  private_nh.getParam("num_worker_threads", num_worker_threads);
 
-  ros::spin();
+  ros::AsyncSpinner spinner(num_worker_threads);
+  spinner.start();
+  ros::waitForShutdown();
 
   return(EXIT_SUCCESS);
 }
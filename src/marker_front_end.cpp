@@ -0,0 +1,419 @@
+/*********************************************************************************************//**
+* @file marker_front_end.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <marker_front_end.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <aruco/arucofidmarkers.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace aruco_tracking
+{
+
+/** \brief Row with radius pixels replicated on both sides */
+static inline void
+padRow(const uint8_t *src, int width, int radius, uint8_t *padded)
+{
+  std::memset(padded, src[0], radius);
+  std::memcpy(padded + radius, src, width);
+  std::memset(padded + radius + width, src[width - 1], radius);
+}
+
+/** \brief Vertical box sums slide by one row, sums += add - subtract */
+static void
+updateColumnSums(uint16_t *sums, const uint8_t *add, const uint8_t *subtract, int n)
+{
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m128i add_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(add + i));
+    const __m128i subtract_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(subtract + i));
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i + 8));
+    low = _mm_sub_epi16(_mm_add_epi16(low, _mm_unpacklo_epi8(add_bytes, zero)), _mm_unpacklo_epi8(subtract_bytes, zero));
+    high = _mm_sub_epi16(_mm_add_epi16(high, _mm_unpackhi_epi8(add_bytes, zero)), _mm_unpackhi_epi8(subtract_bytes, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), low);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i + 8), high);
+  }
+#elif defined(__aarch64__)
+  for(; i + 16 <= n; i += 16)
+  {
+    const uint8x16_t add_bytes = vld1q_u8(add + i);
+    const uint8x16_t subtract_bytes = vld1q_u8(subtract + i);
+    const uint16x8_t low = vsubw_u8(vaddw_u8(vld1q_u16(sums + i), vget_low_u8(add_bytes)), vget_low_u8(subtract_bytes));
+    const uint16x8_t high = vsubw_u8(vaddw_u8(vld1q_u16(sums + i + 8), vget_high_u8(add_bytes)), vget_high_u8(subtract_bytes));
+    vst1q_u16(sums + i, low);
+    vst1q_u16(sums + i + 8, high);
+  }
+#endif
+  for(; i < n; i++)
+    sums[i] = uint16_t(sums[i] + add[i] - subtract[i]);
+}
+
+/** \brief Box sums of one row from its integral, mean rounded to nearest and compared with pixels */
+static void
+thresholdRow(const int32_t *integral, int block_size, float scale, const uint8_t *src, uint8_t *dst,
+             int width, int delta)
+{
+  int x = 0;
+#if defined(__SSE2__)
+  const __m128 scale_vector = _mm_set1_ps(scale);
+  const __m128i limit = _mm_set1_epi16(int16_t(delta - 1));
+  const __m128i zero = _mm_setzero_si128();
+  for(; x + 8 <= width; x += 8)
+  {
+    const __m128i sum_low = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(integral + x + block_size)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(integral + x)));
+    const __m128i sum_high = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(integral + x + 4 + block_size)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(integral + x + 4)));
+    const __m128i mean = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum_low), scale_vector)),
+                                         _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum_high), scale_vector)));
+    const __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)), zero);
+    const __m128i mask = _mm_cmpgt_epi16(_mm_sub_epi16(mean, pixels), limit);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packs_epi16(mask, mask));
+  }
+#elif defined(__aarch64__)
+  const float32x4_t scale_vector = vdupq_n_f32(scale);
+  const int16x8_t limit = vdupq_n_s16(int16_t(delta - 1));
+  for(; x + 8 <= width; x += 8)
+  {
+    const int32x4_t sum_low = vsubq_s32(vld1q_s32(integral + x + block_size), vld1q_s32(integral + x));
+    const int32x4_t sum_high = vsubq_s32(vld1q_s32(integral + x + 4 + block_size), vld1q_s32(integral + x + 4));
+    const int16x8_t mean = vcombine_s16(vmovn_s32(vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(sum_low), scale_vector))),
+                                        vmovn_s32(vcvtnq_s32_f32(vmulq_f32(vcvtq_f32_s32(sum_high), scale_vector))));
+    const int16x8_t pixels = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src + x)));
+    vst1_u8(dst + x, vmovn_u16(vcgtq_s16(vsubq_s16(mean, pixels), limit)));
+  }
+#endif
+  for(; x < width; x++)
+  {
+    const int mean = int(std::nearbyint(float(integral[x + block_size] - integral[x]) * scale));
+    dst[x] = (mean - src[x] > delta - 1) ? 255 : 0;
+  }
+}
+
+void
+adaptiveThresholdMeanInv(const uint8_t *src, size_t src_step, uint8_t *dst, size_t dst_step,
+                         int width, int height, int block_size, int delta,
+                         std::vector<uint8_t> &padded_rows, std::vector<uint16_t> &column_sums,
+                         std::vector<int32_t> &row_integral)
+{
+  if((width <= 0) || (height <= 0))
+    return;
+
+  const int radius = block_size / 2;
+  const int padded_width = width + 2 * radius;
+  const float scale = 1.0f / float(block_size * block_size);
+
+  // Differences of pixel and mean are within +-255
+  delta = std::max(-255, std::min(delta, 256));
+
+  // Row entering the window, row leaving it and a row of zeros
+  padded_rows.assign(3 * padded_width, 0);
+  uint8_t *add_row = &padded_rows[0];
+  uint8_t *subtract_row = &padded_rows[padded_width];
+  const uint8_t *zero_row = &padded_rows[2 * padded_width];
+  column_sums.assign(padded_width, 0);
+  row_integral.resize(padded_width + 1);
+  row_integral[0] = 0;
+
+  // Window of first row, rows above image replicate the first one
+  for(int k = -radius; k <= radius; k++)
+  {
+    padRow(src + std::max(0, std::min(k, height - 1)) * src_step, width, radius, add_row);
+    updateColumnSums(&column_sums[0], add_row, zero_row, padded_width);
+  }
+
+  for(int y = 0; y < height; y++)
+  {
+    if(y > 0)
+    {
+      padRow(src + std::min(y + radius, height - 1) * src_step, width, radius, add_row);
+      padRow(src + std::max(y - radius - 1, 0) * src_step, width, radius, subtract_row);
+      updateColumnSums(&column_sums[0], add_row, subtract_row, padded_width);
+    }
+
+    // Integral of column sums, box sum of a pixel is difference of two entries
+    for(int i = 0; i < padded_width; i++)
+      row_integral[i + 1] = row_integral[i] + column_sums[i];
+
+    thresholdRow(&row_integral[0], block_size, scale, src + y * src_step, dst + y * dst_step, width, delta);
+  }
+}
+
+/** \brief Sum of quad sides, same float arithmetic as aruco so that ties are broken the same */
+static float
+perimeter(const std::vector<cv::Point2f> &points)
+{
+  float sum = 0;
+  for(size_t i = 0; i < points.size(); i++)
+  {
+    const size_t next = (i + 1) % points.size();
+    sum += std::sqrt((points[i].x - points[next].x) * (points[i].x - points[next].x) +
+                     (points[i].y - points[next].y) * (points[i].y - points[next].y));
+  }
+  return sum;
+}
+
+void
+copyMarker(const aruco::Marker &from, aruco::Marker &to)
+{
+  to.assign(from.begin(), from.end());
+  to.id = from.id;
+  to.ssize = from.ssize;
+  from.Rvec.copyTo(to.Rvec);
+  from.Tvec.copyTo(to.Tvec);
+}
+
+MarkerFrontEnd::MarkerFrontEnd() :
+  block_size_ (7),                        // aruco default threshold block size
+  delta_ (7),                             // aruco default threshold constant
+  min_size_ (0.04),                       // Contour limits relative to image size
+  max_size_ (0.5),
+  refine_corners_ (true)                  // Subpixel corner refinement
+{
+}
+
+bool
+MarkerFrontEnd::configure(aruco::MarkerDetector &detector)
+{
+  double param1, param2;
+  detector.getThresholdParams(param1, param2);
+
+  // Block size odd and at least 3, as the library makes it
+  if(param1 < 3)
+    param1 = 3;
+  else if(int(param1) % 2 != 1)
+    param1 = int(param1 + 1);
+  block_size_ = int(param1);
+  delta_ = int(std::floor(param2));
+
+  detector.getMinMaxSize(min_size_, max_size_);
+  refine_corners_ = (detector.getCornerRefinementMethod() == aruco::MarkerDetector::SUBPIX);
+
+  return (detector.getThresholdMethod() == aruco::MarkerDetector::ADPT_THRES) &&
+         (refine_corners_ || (detector.getCornerRefinementMethod() == aruco::MarkerDetector::NONE)) &&
+         (block_size_ <= MAX_BLOCK_SIZE);
+}
+
+void
+MarkerFrontEnd::detect(const cv::Mat &gray, std::vector<aruco::Marker> &markers)
+{
+  //------------------------------------------------------
+  // Threshold and quads
+  //------------------------------------------------------
+  binary_.create(gray.size(), CV_8UC1);
+  adaptiveThresholdMeanInv(gray.data, gray.step, binary_.data, binary_.step, gray.cols, gray.rows,
+                           block_size_, delta_, padded_rows_, column_sums_, row_integral_);
+  const size_t num_of_candidates = findCandidates(binary_, candidates_);
+
+  //------------------------------------------------------
+  // Identification by aruco, corners rotated to marker's orientation.
+  // Markers are written into kept elements, whose buffers are reused
+  //------------------------------------------------------
+  size_t num_of_markers = 0;
+  for(size_t i = 0; i < num_of_candidates; i++)
+  {
+    warp(gray, candidates_[i]);
+
+    int num_of_rotations;
+    const int id = aruco::FiducidalMarkers::detect(canonical_marker_, num_of_rotations);
+    if(id == -1)
+      continue;
+
+    if(num_of_markers == found_markers_.size())
+      found_markers_.push_back(aruco::Marker());
+
+    // Same state as aruco::Marker(corners, id), pose unknown
+    aruco::Marker &marker = found_markers_[num_of_markers++];
+    marker.assign(candidates_[i].begin(), candidates_[i].end());
+    marker.id = id;
+    marker.ssize = -1;
+    marker.Rvec.create(3, 1, CV_32FC1);
+    marker.Tvec.create(3, 1, CV_32FC1);
+    marker.Rvec.setTo(cv::Scalar(UNKNOWN_POSE));
+    marker.Tvec.setTo(cv::Scalar(UNKNOWN_POSE));
+    std::rotate(marker.begin(), marker.begin() + 4 - num_of_rotations, marker.end());
+  }
+
+  //------------------------------------------------------
+  // Subpixel corners, all markers in one call
+  //------------------------------------------------------
+  if(refine_corners_ && (num_of_markers > 0))
+  {
+    corners_.clear();
+    for(size_t i = 0; i < num_of_markers; i++)
+      corners_.insert(corners_.end(), found_markers_[i].begin(), found_markers_[i].end());
+
+    cv::cornerSubPix(gray, corners_, cv::Size(REFINE_HALF_WINDOW, REFINE_HALF_WINDOW), cv::Size(-1,-1),
+                     cv::TermCriteria(cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, REFINE_ITERATIONS, REFINE_EPSILON));
+
+    for(size_t i = 0; i < num_of_markers; i++)
+      std::copy(corners_.begin() + 4 * i, corners_.begin() + 4 * (i + 1), found_markers_[i].begin());
+  }
+
+  //------------------------------------------------------
+  // Marker found twice at its inner and outer border, the larger one is kept.
+  // Order is sorted instead of markers, copies of markers would allocate
+  //------------------------------------------------------
+  marker_order_.resize(num_of_markers);
+  for(size_t i = 0; i < num_of_markers; i++)
+    marker_order_[i] = i;
+  std::sort(marker_order_.begin(), marker_order_.end(),
+            [this](int a, int b) { return found_markers_[a].id < found_markers_[b].id; });
+
+  to_remove_.assign(num_of_markers, false);
+  for(int i = 0; i < int(num_of_markers) - 1; i++)
+  {
+    const aruco::Marker &marker = found_markers_[marker_order_[i]];
+    const aruco::Marker &next_marker = found_markers_[marker_order_[i + 1]];
+    if((marker.id == next_marker.id) && !to_remove_[i + 1])
+    {
+      if(perimeter(marker) > perimeter(next_marker))
+        to_remove_[i + 1] = true;
+      else
+        to_remove_[i] = true;
+    }
+  }
+
+  size_t kept = 0;
+  for(size_t i = 0; i < num_of_markers; i++)
+    kept += to_remove_[i] ? 0 : 1;
+
+  // Size of output changes only with number of markers
+  markers.resize(kept);
+  kept = 0;
+  for(size_t i = 0; i < num_of_markers; i++)
+    if(!to_remove_[i])
+      copyMarker(found_markers_[marker_order_[i]], markers[kept++]);
+}
+
+size_t
+MarkerFrontEnd::findCandidates(cv::Mat &binary, std::vector<std::vector<cv::Point2f> > &candidates)
+{
+  size_t num_of_candidates = 0;
+
+  // Contour length limits in px, truncated as in the library
+  const int max_dimension = std::max(binary.cols, binary.rows);
+  const int min_length = min_size_ * max_dimension * 4;
+  const int max_length = max_size_ * max_dimension * 4;
+
+  // Same retrieval mode as the library, contours come in the same order so ties are broken the same
+  cv::findContours(binary, contours_, contour_hierarchy_, CV_RETR_TREE, CV_CHAIN_APPROX_NONE);
+
+  for(size_t i = 0; i < contours_.size(); i++)
+  {
+    const int length = contours_[i].size();
+    if((length <= min_length) || (length >= max_length))
+      continue;
+
+    cv::approxPolyDP(contours_[i], approx_curve_, double(length) * APPROX_EPSILON_RATIO, true);
+    if((approx_curve_.size() != 4) || !cv::isContourConvex(approx_curve_))
+      continue;
+
+    // Sides shorter than MIN_SIDE are noise
+    bool long_sides = true;
+    for(int j = 0; j < 4; j++)
+    {
+      const cv::Point side = approx_curve_[j] - approx_curve_[(j + 1) % 4];
+      long_sides = long_sides && (side.dot(side) > MIN_SIDE * MIN_SIDE);
+    }
+    if(long_sides == false)
+      continue;
+
+    // Quad written into a kept element, its buffer is reused
+    if(num_of_candidates == candidates.size())
+      candidates.push_back(std::vector<cv::Point2f>());
+    std::vector<cv::Point2f> &quad = candidates[num_of_candidates++];
+    quad.assign(approx_curve_.begin(), approx_curve_.end());
+
+    // Anti-clockwise order, third point on the right side of the first side
+    const double orientation = double(quad[1].x - quad[0].x) * double(quad[2].y - quad[0].y) -
+                               double(quad[1].y - quad[0].y) * double(quad[2].x - quad[0].x);
+    if(orientation < 0.0)
+      std::swap(quad[1], quad[3]);
+  }
+
+  // Of two candidates with close corners on average, the one with larger perimeter is kept
+  to_remove_.assign(num_of_candidates, false);
+  for(size_t i = 0; i < num_of_candidates; i++)
+  {
+    for(size_t j = i + 1; j < num_of_candidates; j++)
+    {
+      float distance = 0;
+      for(int c = 0; c < 4; c++)
+      {
+        const cv::Point2f difference = candidates[i][c] - candidates[j][c];
+        distance += std::sqrt(difference.dot(difference));
+      }
+      if(distance / 4 >= MIN_MEAN_CORNER_DISTANCE)
+        continue;
+
+      if(perimeter(candidates[i]) > perimeter(candidates[j]))
+        to_remove_[j] = true;
+      else
+        to_remove_[i] = true;
+    }
+  }
+
+  // Removed quads are swapped behind the kept ones, no buffer is freed
+  size_t kept = 0;
+  for(size_t i = 0; i < num_of_candidates; i++)
+    if(!to_remove_[i])
+      candidates[kept++].swap(candidates[i]);
+  return kept;
+}
+
+void
+MarkerFrontEnd::warp(const cv::Mat &gray, const std::vector<cv::Point2f> &candidate)
+{
+  const cv::Point2f canonical_corners[4] = {cv::Point2f(0, 0),
+                                            cv::Point2f(WARP_SIZE - 1, 0),
+                                            cv::Point2f(WARP_SIZE - 1, WARP_SIZE - 1),
+                                            cv::Point2f(0, WARP_SIZE - 1)};
+  const cv::Point2f candidate_corners[4] = {candidate[0], candidate[1], candidate[2], candidate[3]};
+
+  const cv::Mat homography = cv::getPerspectiveTransform(candidate_corners, canonical_corners);
+  cv::warpPerspective(gray, canonical_marker_, homography, cv::Size(WARP_SIZE, WARP_SIZE), cv::INTER_NEAREST);
+}
+
+}  //aruco_tracking namespace
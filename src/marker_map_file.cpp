@@ -0,0 +1,112 @@
+/*********************************************************************************************//**
+* @file marker_map_file.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <marker_map_file.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace aruco_tracking
+{
+
+static const char MARKER_MAP_FILE_MAGIC[4] = {'A', 'T', 'M', 'P'};
+
+bool
+saveMarkerMap(const std::string &filename, const std::vector<MarkerMapRecord> &records)
+{
+  MarkerMapFileHeader header;
+  std::memcpy(header.magic, MARKER_MAP_FILE_MAGIC, sizeof(header.magic));
+  header.version = MARKER_MAP_FILE_VERSION;
+  header.num_of_markers = records.size();
+  header.record_size = sizeof(MarkerMapRecord);
+
+  const std::string temp_filename = filename + ".tmp";
+  FILE *file = std::fopen(temp_filename.c_str(), "wb");
+  if(file == NULL)
+    return false;
+
+  bool written = (std::fwrite(&header, sizeof(header), 1, file) == 1);
+  if(written && !records.empty())
+    written = (std::fwrite(records.data(), sizeof(MarkerMapRecord), records.size(), file) == records.size());
+
+  if((std::fclose(file) != 0) || !written)
+  {
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+
+  return std::rename(temp_filename.c_str(), filename.c_str()) == 0;
+}
+
+bool
+loadMarkerMap(const std::string &filename, std::vector<MarkerMapRecord> &records)
+{
+  records.clear();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat file_stat;
+  if((fstat(fd, &file_stat) != 0) || (size_t(file_stat.st_size) < sizeof(MarkerMapFileHeader)))
+  {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED)
+    return false;
+
+  // Check header before trusting number of records
+  const MarkerMapFileHeader *header = static_cast<const MarkerMapFileHeader *>(data);
+  const size_t expected_size = sizeof(MarkerMapFileHeader) + size_t(header->num_of_markers) * sizeof(MarkerMapRecord);
+  const bool valid = (std::memcmp(header->magic, MARKER_MAP_FILE_MAGIC, sizeof(header->magic)) == 0) &&
+                     (header->version == MARKER_MAP_FILE_VERSION) &&
+                     (header->record_size == sizeof(MarkerMapRecord)) &&
+                     (size_t(file_stat.st_size) == expected_size);
+
+  if(valid)
+  {
+    const MarkerMapRecord *first = reinterpret_cast<const MarkerMapRecord *>(header + 1);
+    records.assign(first, first + header->num_of_markers);
+  }
+
+  munmap(data, file_stat.st_size);
+  return valid;
+}
+
+}  //aruco_tracking namespace
@@ -0,0 +1,145 @@
+/*********************************************************************************************//**
+* @file marker_store.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <marker_store.h>
+
+#include <algorithm>
+
+namespace aruco_tracking
+{
+
+CompactPose::CompactPose()
+{
+  position[0] = position[1] = position[2] = 0;
+  orientation[0] = orientation[1] = orientation[2] = 0;
+  orientation[3] = 1;
+}
+
+tf::Transform
+CompactPose::toTf() const
+{
+  return tf::Transform(tf::Quaternion(orientation[0], orientation[1], orientation[2], orientation[3]),
+                       tf::Vector3(position[0], position[1], position[2]));
+}
+
+void
+CompactPose::fromTf(const tf::Transform &transform)
+{
+  const tf::Vector3 &origin = transform.getOrigin();
+  const tf::Quaternion rotation = transform.getRotation();
+  position[0] = origin.getX();
+  position[1] = origin.getY();
+  position[2] = origin.getZ();
+  orientation[0] = rotation.getX();
+  orientation[1] = rotation.getY();
+  orientation[2] = rotation.getZ();
+  orientation[3] = rotation.getW();
+}
+
+void
+CompactPose::toMsg(geometry_msgs::Pose &pose) const
+{
+  pose.position.x = position[0];
+  pose.position.y = position[1];
+  pose.position.z = position[2];
+  pose.orientation.x = orientation[0];
+  pose.orientation.y = orientation[1];
+  pose.orientation.z = orientation[2];
+  pose.orientation.w = orientation[3];
+}
+
+MarkerStore::MarkerStore() :
+  known_(CAPACITY, 0),
+  visible_(CAPACITY, 0),
+  previous_(CAPACITY, -1),
+  next_(CAPACITY),
+  to_previous_(CAPACITY),
+  to_world_(CAPACITY),
+  last_seen_(CAPACITY)
+{
+  ids_.reserve(CAPACITY);
+}
+
+bool
+MarkerStore::add(int id)
+{
+  if((id < 0) || (id >= CAPACITY))
+    return false;
+  if(known_[id])
+    return true;
+
+  known_[id] = 1;
+  visible_[id] = 0;
+  setPrevious(id, -1);
+  to_previous_[id] = CompactPose();
+  to_world_[id] = CompactPose();
+  last_seen_[id] = ros::Time();
+  ids_.insert(std::lower_bound(ids_.begin(), ids_.end(), id), id);
+  return true;
+}
+
+void
+MarkerStore::clear()
+{
+  for(size_t i = 0; i < ids_.size(); i++)
+  {
+    known_[ids_[i]] = 0;
+    visible_[ids_[i]] = 0;
+    previous_[ids_[i]] = -1;
+    next_[ids_[i]].clear();
+  }
+  ids_.clear();
+}
+
+void
+MarkerStore::setPrevious(int id, int previous_id)
+{
+  // Parent of the first marker and of unchained ones is negative, they are nobody's child
+  const int old_previous_id = previous_[id];
+  if((old_previous_id >= 0) && (old_previous_id < CAPACITY))
+  {
+    std::vector<int> &siblings = next_[old_previous_id];
+    siblings.erase(std::remove(siblings.begin(), siblings.end(), id), siblings.end());
+  }
+
+  previous_[id] = previous_id;
+  if((previous_id >= 0) && (previous_id < CAPACITY))
+    next_[previous_id].push_back(id);
+}
+
+void
+MarkerStore::resetVisibility()
+{
+  for(size_t i = 0; i < ids_.size(); i++)
+    visible_[ids_[i]] = 0;
+}
+
+}  //aruco_tracking namespace
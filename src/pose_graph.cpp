@@ -0,0 +1,221 @@
+/*********************************************************************************************//**
+* @file pose_graph.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <pose_graph.h>
+
+#include <algorithm>
+
+namespace aruco_tracking
+{
+
+PoseGraph::PoseGraph() :
+  planar_ (false)
+{
+}
+
+void
+PoseGraph::addNode(int id, const tf::Transform &pose_to_world, bool fixed)
+{
+  Node &node = nodes_[id];
+  node.pose_to_world = constrain(pose_to_world);
+  node.fixed = fixed;
+
+  if(id >= int(visited_.size()))
+    visited_.resize(id + 1, 0);
+}
+
+bool
+PoseGraph::hasNode(int id) const
+{
+  return nodes_.count(id) > 0;
+}
+
+const tf::Transform &
+PoseGraph::pose(int id) const
+{
+  return nodes_.find(id)->second.pose_to_world;
+}
+
+void
+PoseGraph::setPlanar(bool planar)
+{
+  planar_ = planar;
+}
+
+void
+PoseGraph::clear()
+{
+  nodes_.clear();
+  edges_.clear();
+}
+
+void
+PoseGraph::addMeasurement(int from, int to, const tf::Transform &from_to_to)
+{
+  if((from == to) || !hasNode(from) || !hasNode(to))
+    return;
+
+  // Edge is kept in one direction only
+  const std::pair<int, int> key(std::min(from, to), std::max(from, to));
+  const tf::Transform measurement = (from < to) ? from_to_to : from_to_to.inverse();
+
+  std::map<std::pair<int, int>, Edge>::iterator it = edges_.find(key);
+  if(it == edges_.end())
+  {
+    Edge edge;
+    edge.translation = measurement.getOrigin();
+    edge.rotation = measurement.getRotation();
+    edge.weight = 1.0;
+    edges_[key] = edge;
+    nodes_[from].neighbours.push_back(to);
+    nodes_[to].neighbours.push_back(from);
+    return;
+  }
+
+  // Running mean, quaternion flipped to the same hemisphere before blending
+  Edge &edge = it->second;
+  if(edge.weight < EDGE_MAX_WEIGHT)
+    edge.weight += 1.0;
+  const double alpha = 1.0 / edge.weight;
+  tf::Quaternion rotation = measurement.getRotation();
+  if(rotation.dot(edge.rotation) < 0)
+    rotation = -rotation;
+
+  edge.translation += (measurement.getOrigin() - edge.translation) * alpha;
+  edge.rotation = (edge.rotation * (1.0 - alpha) + rotation * alpha).normalized();
+}
+
+tf::Transform
+PoseGraph::relativePose(int from, int to, double &weight) const
+{
+  const std::pair<int, int> key(std::min(from, to), std::max(from, to));
+  const Edge &edge = edges_.find(key)->second;
+  weight = edge.weight;
+
+  const tf::Transform relative(edge.rotation, edge.translation);
+  return (from < to) ? relative : relative.inverse();
+}
+
+tf::Transform
+PoseGraph::constrain(const tf::Transform &pose) const
+{
+  if(!planar_)
+    return pose;
+
+  double roll, pitch, yaw;
+  tf::Matrix3x3(pose.getRotation()).getRPY(roll, pitch, yaw);
+  tf::Quaternion rotation;
+  rotation.setRPY(0, 0, yaw);
+  tf::Vector3 origin = pose.getOrigin();
+  origin.setZ(0);
+  return tf::Transform(rotation, origin);
+}
+
+void
+PoseGraph::optimize(const std::vector<int> &touched, int hops, int max_nodes, int iterations, std::vector<int> &updated)
+{
+  updated.clear();
+
+  //------------------------------------------------------
+  // Local neighbourhood, breadth first from touched markers
+  //------------------------------------------------------
+  open_.clear();
+  for(size_t i = 0; i < touched.size(); i++)
+  {
+    if(hasNode(touched[i]) && !visited_[touched[i]])
+    {
+      visited_[touched[i]] = 1;
+      open_.push_back(std::make_pair(touched[i], 0));
+    }
+  }
+
+  for(size_t head = 0; (head < open_.size()) && ((int)updated.size() < max_nodes); head++)
+  {
+    const int id = open_[head].first;
+    const int depth = open_[head].second;
+
+    const Node &node = nodes_[id];
+    if(!node.fixed)
+      updated.push_back(id);
+
+    if(depth >= hops)
+      continue;
+    for(size_t i = 0; i < node.neighbours.size(); i++)
+    {
+      if(!visited_[node.neighbours[i]])
+      {
+        visited_[node.neighbours[i]] = 1;
+        open_.push_back(std::make_pair(node.neighbours[i], depth + 1));
+      }
+    }
+  }
+
+  // Every visited marker went through the queue
+  for(size_t i = 0; i < open_.size(); i++)
+    visited_[open_[i].first] = 0;
+
+  //------------------------------------------------------
+  // Gauss-Seidel relaxation, markers outside the neighbourhood act as anchors
+  //------------------------------------------------------
+  for(int iteration = 0; iteration < iterations; iteration++)
+  {
+    for(size_t i = 0; i < updated.size(); i++)
+    {
+      Node &node = nodes_[updated[i]];
+      if(node.neighbours.empty())
+        continue;
+
+      const tf::Quaternion reference = node.pose_to_world.getRotation();
+      tf::Vector3 translation(0, 0, 0);
+      tf::Quaternion rotation(0, 0, 0, 0);
+      double weight_sum = 0;
+
+      // Pose predicted by every neighbour, weighted by number of measurements of the edge
+      for(size_t k = 0; k < node.neighbours.size(); k++)
+      {
+        double weight;
+        const tf::Transform prediction = nodes_[node.neighbours[k]].pose_to_world *
+                                         relativePose(node.neighbours[k], updated[i], weight);
+        tf::Quaternion predicted_rotation = prediction.getRotation();
+        if(predicted_rotation.dot(reference) < 0)
+          predicted_rotation = -predicted_rotation;
+
+        translation += prediction.getOrigin() * weight;
+        rotation += predicted_rotation * weight;
+        weight_sum += weight;
+      }
+
+      node.pose_to_world = constrain(tf::Transform(rotation.normalized(), translation / weight_sum));
+    }
+  }
+}
+
+}  //aruco_tracking namespace
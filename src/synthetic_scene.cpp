@@ -0,0 +1,166 @@
+/*********************************************************************************************//**
+* @file synthetic_scene.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <synthetic_scene.h>
+
+#include <cmath>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <aruco/arucofidmarkers.h>
+
+namespace aruco_tracking
+{
+
+SyntheticScene::SyntheticScene(const cv::Mat &camera_matrix, const cv::Mat &distortion, const cv::Size &image_size,
+                               const Options &options) :
+  image_size_(image_size),
+  options_(options),
+  rng_(options.seed)
+{
+  camera_matrix.convertTo(camera_matrix_, CV_64F);
+  distortion.convertTo(distortion_, CV_64F);
+
+  // Same dictionary as the detector
+  for(int i = 0; i < options_.num_of_markers; i++)
+    marker_images_.push_back(aruco::FiducidalMarkers::createMarkerImage(options_.first_marker_id + i, MARKER_IMAGE_SIZE));
+
+  // Scene is rendered by an ideal pinhole camera, lens distortion applied afterwards by remap.
+  // Every pixel of distorted image looks up its undistorted position once
+  if(cv::countNonZero(distortion_) > 0)
+  {
+    std::vector<cv::Point2f> pixels, normalized;
+    pixels.reserve(image_size_.area());
+    for(int y = 0; y < image_size_.height; y++)
+      for(int x = 0; x < image_size_.width; x++)
+        pixels.push_back(cv::Point2f(x, y));
+    cv::undistortPoints(pixels, normalized, camera_matrix_, distortion_);
+
+    const double fx = camera_matrix_.at<double>(0,0), fy = camera_matrix_.at<double>(1,1);
+    const double cx = camera_matrix_.at<double>(0,2), cy = camera_matrix_.at<double>(1,2);
+    distort_map_x_.create(image_size_, CV_32F);
+    distort_map_y_.create(image_size_, CV_32F);
+    for(int y = 0; y < image_size_.height; y++)
+    {
+      for(int x = 0; x < image_size_.width; x++)
+      {
+        const cv::Point2f &point = normalized[y * image_size_.width + x];
+        distort_map_x_.at<float>(y, x) = fx * point.x + cx;
+        distort_map_y_.at<float>(y, x) = fy * point.y + cy;
+      }
+    }
+  }
+}
+
+void
+SyntheticScene::render(int frame_index, int num_of_frames, cv::Mat &image, tf::Transform &camera_to_first_marker)
+{
+  //------------------------------------------------------
+  // Camera trajectory - markers face the camera, which sways, tilts and moves closer and further
+  //------------------------------------------------------
+  const double phase = 2 * M_PI * frame_index / std::max(num_of_frames, 1);
+  const cv::Vec3d tilt(0.25 * std::sin(phase), 0.2 * std::sin(2 * phase), 0.3 * std::sin(0.5 * phase));
+  cv::Matx33d tilt_rotation;
+  cv::Rodrigues(tilt, tilt_rotation);
+
+  // Marker z axis towards camera, so its texture is not mirrored
+  const cv::Matx33d facing(1, 0, 0,
+                           0, -1, 0,
+                           0, 0, -1);
+  const cv::Matx33d rotation = tilt_rotation * facing;
+  const cv::Vec3d translation(0.1 * std::sin(phase), 0.05 * std::cos(phase),
+                              options_.distance * options_.distance_scale * (1 + 0.2 * std::sin(3 * phase)));
+
+  //------------------------------------------------------
+  // Markers warped into ideal image, corner order as in aruco::Marker::calculateExtrinsics
+  //------------------------------------------------------
+  ideal_image_.create(image_size_, CV_8UC1);
+  ideal_image_.setTo(cv::Scalar(BACKGROUND));
+
+  const double h = options_.marker_size / 2;
+  const cv::Vec3d corners[4] = {cv::Vec3d(-h, -h, 0), cv::Vec3d(-h, h, 0), cv::Vec3d(h, h, 0), cv::Vec3d(h, -h, 0)};
+  const float edge = MARKER_IMAGE_SIZE - 0.5f;
+  const cv::Point2f texture[4] = {cv::Point2f(-0.5f, -0.5f), cv::Point2f(edge, -0.5f),
+                                  cv::Point2f(edge, edge), cv::Point2f(-0.5f, edge)};
+
+  for(int i = 0; i < options_.num_of_markers; i++)
+  {
+    // Row along marker x axis, which stays in plane of markers
+    const cv::Vec3d offset((i - 0.5 * (options_.num_of_markers - 1)) * options_.marker_spacing, 0, 0);
+
+    cv::Point2f projected[4];
+    for(int k = 0; k < 4; k++)
+    {
+      const cv::Vec3d point = rotation * (corners[k] + offset) + translation;
+      projected[k] = cv::Point2f(camera_matrix_.at<double>(0,0) * point[0] / point[2] + camera_matrix_.at<double>(0,2),
+                                 camera_matrix_.at<double>(1,1) * point[1] / point[2] + camera_matrix_.at<double>(1,2));
+    }
+
+    const cv::Mat homography = cv::getPerspectiveTransform(texture, projected);
+    cv::warpPerspective(marker_images_[i], ideal_image_, homography, image_size_, cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+  }
+
+  //------------------------------------------------------
+  // Lens distortion, blur and noise
+  //------------------------------------------------------
+  if(!distort_map_x_.empty())
+    cv::remap(ideal_image_, image, distort_map_x_, distort_map_y_, cv::INTER_LINEAR, cv::BORDER_CONSTANT,
+              cv::Scalar(BACKGROUND));
+  else
+    ideal_image_.copyTo(image);
+
+  if(options_.blur_sigma > 0)
+    cv::GaussianBlur(image, image, cv::Size(0, 0), options_.blur_sigma);
+
+  if(options_.noise_sigma > 0)
+  {
+    noise_.create(image_size_, CV_16SC1);
+    rng_.fill(noise_, cv::RNG::NORMAL, 0, options_.noise_sigma);
+    cv::add(image, noise_, image, cv::noArray(), CV_8U);
+  }
+
+  //------------------------------------------------------
+  // Ground truth - first marker in camera, rotated to ROS marker frame as in ArucoTracking::arucoMarker2Tf
+  //------------------------------------------------------
+  const cv::Vec3d first_offset(-0.5 * (options_.num_of_markers - 1) * options_.marker_spacing, 0, 0);
+  const cv::Vec3d first_origin = rotation * first_offset + translation;
+  const cv::Matx33d rotate_to_ros(-1, 0, 0,
+                                  0, 0, 1,
+                                  0, 1, 0);
+  const cv::Matx33d first_rotation = rotation * rotate_to_ros;
+
+  const tf::Transform first_marker_in_camera(tf::Matrix3x3(first_rotation(0,0), first_rotation(0,1), first_rotation(0,2),
+                                                           first_rotation(1,0), first_rotation(1,1), first_rotation(1,2),
+                                                           first_rotation(2,0), first_rotation(2,1), first_rotation(2,2)),
+                                             tf::Vector3(first_origin[0], first_origin[1], first_origin[2]));
+  camera_to_first_marker = first_marker_in_camera.inverse();
+}
+
+}  //aruco_tracking namespace
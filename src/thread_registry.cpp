@@ -0,0 +1,64 @@
+/*********************************************************************************************//**
+* @file thread_registry.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <thread_registry.h>
+
+#include <atomic>
+
+namespace aruco_tracking
+{
+
+uint64_t
+nextThreadRegistryInstance()
+{
+  static std::atomic<uint64_t> next_instance(1);
+  return next_instance++;
+}
+
+bool
+writeFileAtomically(const std::string &filename, const boost::function<bool (FILE *file)> &write)
+{
+  const std::string temp_filename = filename + ".tmp";
+  FILE *file = std::fopen(temp_filename.c_str(), "w");
+  if(file == NULL)
+    return false;
+
+  const bool written = write(file) && (std::ferror(file) == 0);
+  if((std::fclose(file) != 0) || !written)
+  {
+    std::remove(temp_filename.c_str());
+    return false;
+  }
+
+  return std::rename(temp_filename.c_str(), filename.c_str()) == 0;
+}
+
+}  //aruco_tracking namespace
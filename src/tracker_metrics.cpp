@@ -0,0 +1,213 @@
+/*********************************************************************************************//**
+* @file tracker_metrics.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <tracker_metrics.h>
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace aruco_tracking
+{
+
+constexpr double TrackerMetrics::FIRST_BUCKET_BOUND;
+
+static const char *COUNTER_NAMES[TrackerMetrics::NUM_OF_COUNTERS] =
+  {"frames_received", "frames_dropped", "frames_processed", "markers_detected", "markers_chained"};
+
+static const char *STAGE_NAMES[TrackerMetrics::NUM_OF_STAGES] =
+  {"convert", "detect", "map", "pose", "publish", "tf_send"};
+
+/** \brief Only the owning thread writes, no read-modify-write instruction needed */
+static inline void
+add(std::atomic<uint64_t> &value, uint64_t n)
+{
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+TrackerMetrics::ThreadAccumulator::ThreadAccumulator()
+{
+  for(int i = 0; i < NUM_OF_COUNTERS; i++)
+    counters[i].store(0, std::memory_order_relaxed);
+  for(int i = 0; i < NUM_OF_STAGES; i++)
+  {
+    for(int j = 0; j < NUM_OF_BUCKETS; j++)
+      buckets[i][j].store(0, std::memory_order_relaxed);
+    sum_ns[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+TrackerMetrics::TrackerMetrics()
+{
+}
+
+void
+TrackerMetrics::count(Counter counter, uint64_t n)
+{
+  add(accumulators_.local().counters[counter], n);
+}
+
+void
+TrackerMetrics::observe(Stage stage, double seconds)
+{
+  int bucket = 0;
+  double bound = FIRST_BUCKET_BOUND;
+  while((bucket < NUM_OF_BUCKETS - 1) && (seconds > bound))
+  {
+    bound *= 2;
+    bucket++;
+  }
+
+  ThreadAccumulator &accumulator = accumulators_.local();
+  add(accumulator.buckets[stage][bucket], 1);
+  add(accumulator.sum_ns[stage], uint64_t(seconds * 1e9));
+}
+
+void
+TrackerMetrics::snapshot(Snapshot &snapshot)
+{
+  std::memset(&snapshot, 0, sizeof(snapshot));
+
+  accumulators_.forEach([&snapshot](size_t, const ThreadAccumulator &accumulator)
+  {
+    for(int i = 0; i < NUM_OF_COUNTERS; i++)
+      snapshot.counters[i] += accumulator.counters[i].load(std::memory_order_relaxed);
+
+    for(int i = 0; i < NUM_OF_STAGES; i++)
+    {
+      Histogram &histogram = snapshot.stages[i];
+      for(int j = 0; j < NUM_OF_BUCKETS; j++)
+      {
+        const uint64_t samples = accumulator.buckets[i][j].load(std::memory_order_relaxed);
+        histogram.buckets[j] += samples;
+        histogram.count += samples;
+      }
+      histogram.sum += accumulator.sum_ns[i].load(std::memory_order_relaxed) * 1e-9;
+    }
+  });
+}
+
+void
+TrackerMetrics::difference(const Snapshot &current, const Snapshot &previous, Snapshot &result)
+{
+  for(int i = 0; i < NUM_OF_COUNTERS; i++)
+    result.counters[i] = current.counters[i] - previous.counters[i];
+
+  for(int i = 0; i < NUM_OF_STAGES; i++)
+  {
+    for(int j = 0; j < NUM_OF_BUCKETS; j++)
+      result.stages[i].buckets[j] = current.stages[i].buckets[j] - previous.stages[i].buckets[j];
+    result.stages[i].count = current.stages[i].count - previous.stages[i].count;
+    result.stages[i].sum = current.stages[i].sum - previous.stages[i].sum;
+  }
+}
+
+double
+TrackerMetrics::bucketBound(int bucket)
+{
+  if(bucket >= NUM_OF_BUCKETS - 1)
+    return std::numeric_limits<double>::infinity();
+  return FIRST_BUCKET_BOUND * double(uint64_t(1) << bucket);
+}
+
+double
+TrackerMetrics::percentile(const Histogram &histogram, double p)
+{
+  if(histogram.count == 0)
+    return 0;
+
+  const double rank = p * histogram.count;
+  uint64_t cumulative = 0;
+  for(int i = 0; i < NUM_OF_BUCKETS - 1; i++)
+  {
+    cumulative += histogram.buckets[i];
+    if(cumulative >= rank)
+      return bucketBound(i);
+  }
+
+  // Unbounded bucket, twice the last finite bound at least
+  return 2 * bucketBound(NUM_OF_BUCKETS - 2);
+}
+
+const char *
+TrackerMetrics::counterName(Counter counter)
+{
+  return COUNTER_NAMES[counter];
+}
+
+const char *
+TrackerMetrics::stageName(Stage stage)
+{
+  return STAGE_NAMES[stage];
+}
+
+/** \brief Snapshot in Prometheus text exposition format */
+static bool
+writePrometheusText(FILE *file, const TrackerMetrics::Snapshot &snapshot)
+{
+  const int NUM_OF_COUNTERS = TrackerMetrics::NUM_OF_COUNTERS;
+  const int NUM_OF_STAGES = TrackerMetrics::NUM_OF_STAGES;
+  const int NUM_OF_BUCKETS = TrackerMetrics::NUM_OF_BUCKETS;
+
+  for(int i = 0; i < NUM_OF_COUNTERS; i++)
+  {
+    std::fprintf(file, "# TYPE aruco_tracking_%s_total counter\n", COUNTER_NAMES[i]);
+    std::fprintf(file, "aruco_tracking_%s_total %llu\n", COUNTER_NAMES[i], (unsigned long long)snapshot.counters[i]);
+  }
+
+  std::fprintf(file, "# TYPE aruco_tracking_stage_seconds histogram\n");
+  for(int i = 0; i < NUM_OF_STAGES; i++)
+  {
+    const TrackerMetrics::Histogram &histogram = snapshot.stages[i];
+    uint64_t cumulative = 0;
+    for(int j = 0; j < NUM_OF_BUCKETS - 1; j++)
+    {
+      cumulative += histogram.buckets[j];
+      std::fprintf(file, "aruco_tracking_stage_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                   STAGE_NAMES[i], TrackerMetrics::bucketBound(j), (unsigned long long)cumulative);
+    }
+    std::fprintf(file, "aruco_tracking_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n",
+                 STAGE_NAMES[i], (unsigned long long)histogram.count);
+    std::fprintf(file, "aruco_tracking_stage_seconds_sum{stage=\"%s\"} %.9f\n", STAGE_NAMES[i], histogram.sum);
+    std::fprintf(file, "aruco_tracking_stage_seconds_count{stage=\"%s\"} %llu\n",
+                 STAGE_NAMES[i], (unsigned long long)histogram.count);
+  }
+
+  return true;
+}
+
+bool
+TrackerMetrics::writePrometheus(const std::string &filename, const Snapshot &snapshot)
+{
+  return writeFileAtomically(filename, [&snapshot](FILE *file) { return writePrometheusText(file, snapshot); });
+}
+
+}  //aruco_tracking namespace
@@ -0,0 +1,354 @@
+/*********************************************************************************************//**
+* @file heap_allocation_test.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <cv_bridge/cv_bridge.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+#include <camera_calibration_parsers/parse_ini.h>
+#include <aruco_tracking.h>
+#include <synthetic_scene.h>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+/** \brief Steady state frames must not allocate from the heap in package code.
+ *         Global operator new counts allocations while enabled, an allocation is attributed to the
+ *         innermost caller outside of the C++ runtime. Allocations made inside third-party libraries
+ *         (ROS, OpenCV, aruco) are not counted.
+ *
+ *         cv::Mat buffers come from cv::fastMalloc, not operator new, and are not seen by this test.
+ *         OpenCV functions allocate their own temporaries, so malloc is not hooked. Mats owned by package
+ *         code are kept as members and written in place with create(), which reuses a buffer of the
+ *         same size and type. */
+
+namespace
+{
+
+std::atomic<bool> counting(false);
+std::atomic<size_t> package_allocations(0);
+thread_local bool in_allocation = false;
+
+// Backtraces of first counted allocations, printed when the test fails
+const int MAX_REPORTED = 8;
+const int MAX_FRAMES = 32;
+void *reported[MAX_REPORTED][MAX_FRAMES];
+int reported_frames[MAX_REPORTED];
+
+const int WARMUP_FRAMES = 30;
+const int MEASURED_FRAMES = 100;
+const int FRAME_TIMEOUT = 10;
+
+/** \brief Parameters changed by some scenario, removed before every scenario so the tracker's defaults apply */
+const char *SCENARIO_PARAMS[] = {"pipeline_enabled", "detection_period", "dynamic_roi", "detection_tiles_x",
+                                 "detection_tiles_y", "fast_front_end"};
+
+std::atomic<size_t> frames_done(0);
+
+/** \brief Libraries of the C++ runtime, their frames are skipped when looking for the caller */
+bool
+isRuntime(const char *filename)
+{
+  static const char *RUNTIME[] = {"libstdc++", "libc.so", "libc-", "libgcc_s", "libpthread", "libm.so", "ld-linux"};
+  for(size_t i = 0; i < sizeof(RUNTIME) / sizeof(RUNTIME[0]); i++)
+    if(std::strstr(filename, RUNTIME[i]))
+      return true;
+  return false;
+}
+
+/** \brief Package code lives in the core library, or in this executable if it is linked statically */
+bool
+isPackage(const Dl_info &info)
+{
+  static Dl_info self;
+  static const bool self_found = dladdr(reinterpret_cast<void *>(&isRuntime), &self) != 0;
+  return (self_found && (info.dli_fbase == self.dli_fbase)) ||
+         (info.dli_fname && std::strstr(info.dli_fname, "libaruco_tracking"));
+}
+
+// Never inlined, first two frames of a backtrace are this function and operator new
+__attribute__((noinline)) void
+recordAllocation()
+{
+  if(!counting.load(std::memory_order_relaxed) || in_allocation)
+    return;
+  in_allocation = true;
+
+  void *frames[MAX_FRAMES];
+  const int num_of_frames = backtrace(frames, MAX_FRAMES);
+
+  bool counted = true;
+  for(int i = 2; i < num_of_frames; i++)
+  {
+    Dl_info info;
+    if(!dladdr(frames[i], &info) || !info.dli_fname || isRuntime(info.dli_fname))
+      continue;
+    counted = isPackage(info);
+    break;
+  }
+
+  if(counted)
+  {
+    const size_t index = package_allocations++;
+    if(index < MAX_REPORTED)
+    {
+      std::memcpy(reported[index], frames, sizeof(frames));
+      reported_frames[index] = num_of_frames;
+    }
+  }
+  in_allocation = false;
+}
+
+void
+frameTimingCallback(int camera_index, const std_msgs::Header &header,
+                    const aruco_tracking::ArucoTracking::FrameTiming &timing,
+                    const aruco_tracking::ArucoMarkerConstPtr &marker_msg)
+{
+  frames_done++;
+}
+
+/** \brief Waits until total frames are finished, pipeline completes them in its own threads */
+bool
+waitForFrames(size_t total)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while(frames_done < total)
+  {
+    if(std::chrono::steady_clock::now() - start > std::chrono::seconds(FRAME_TIMEOUT))
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+/** \brief Still synthetic frame, every frame of a test is the same image so the scene is steady */
+sensor_msgs::ImageConstPtr
+renderFrame(ros::NodeHandle &private_nh)
+{
+  std::string calib_filename;
+  double marker_size = 0.135;
+  private_nh.getParam("calibration_file", calib_filename);
+  private_nh.getParam("marker_size", marker_size);
+
+  sensor_msgs::CameraInfo camera_info;
+  std::string camera_name;
+  if(!camera_calibration_parsers::readCalibrationIni(calib_filename, camera_name, camera_info))
+    return sensor_msgs::ImageConstPtr();
+
+  cv::Mat camera_matrix(3, 3, CV_64F), distortion = cv::Mat::zeros(1, 5, CV_64F);
+  for(int i = 0; i < 9; i++)
+    camera_matrix.at<double>(i / 3, i % 3) = camera_info.K[i];
+  for(size_t i = 0; i < std::min(camera_info.D.size(), size_t(5)); i++)
+    distortion.at<double>(0, i) = camera_info.D[i];
+
+  aruco_tracking::SyntheticScene::Options options;
+  options.marker_size = marker_size;
+  aruco_tracking::SyntheticScene scene(camera_matrix, distortion, cv::Size(camera_info.width, camera_info.height),
+                                       options);
+  cv::Mat image;
+  tf::Transform truth;
+  scene.render(0, 1, image, truth);
+
+  std_msgs::Header header;
+  header.frame_id = "camera";
+  return cv_bridge::CvImage(header, sensor_msgs::image_encodings::MONO8, image).toImageMsg();
+}
+
+/** \brief Runs warm-up frames, then counts package allocations of measured frames. Scenario parameters
+ *         are set in the private namespace by the caller */
+size_t
+countSteadyStateAllocations(bool debug_image)
+{
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+
+  sensor_msgs::ImageConstPtr image = renderFrame(private_nh);
+  EXPECT_TRUE(image != NULL) << "Calibration not readable";
+  if(!image)
+    return 0;
+
+  aruco_tracking::ArucoTracking tracker(&nh, &private_nh);
+  tracker.setFrameTimingCallback(&frameTimingCallback);
+
+  // Debug image is rendered only while somebody listens
+  image_transport::ImageTransport it(nh);
+  image_transport::Subscriber debug_sub;
+  if(debug_image)
+    debug_sub = it.subscribe("debug_image", 1, [](const sensor_msgs::ImageConstPtr &) {});
+
+  frames_done = 0;
+  for(int i = 0; i < WARMUP_FRAMES; i++)
+    tracker.imageCallback(image, 0);
+  EXPECT_TRUE(waitForFrames(WARMUP_FRAMES));
+
+  package_allocations = 0;
+  counting = true;
+  for(int i = 0; i < MEASURED_FRAMES; i++)
+    tracker.imageCallback(image, 0);
+  EXPECT_TRUE(waitForFrames(WARMUP_FRAMES + MEASURED_FRAMES));
+  counting = false;
+
+  const size_t allocations = package_allocations;
+  for(size_t i = 0; i < std::min(allocations, size_t(MAX_REPORTED)); i++)
+  {
+    std::cerr << "Allocation " << i << ":" << std::endl;
+    backtrace_symbols_fd(reported[i], reported_frames[i], STDERR_FILENO);
+  }
+  return allocations;
+}
+
+}  // namespace
+
+void *
+operator new(std::size_t size)
+{
+  recordAllocation();
+  void *pointer = std::malloc(size ? size : 1);
+  if(!pointer)
+    throw std::bad_alloc();
+  return pointer;
+}
+
+void *
+operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void *
+operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  recordAllocation();
+  return std::malloc(size ? size : 1);
+}
+
+void *
+operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+  return operator new(size, tag);
+}
+
+void
+operator delete(void *pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void
+operator delete[](void *pointer) noexcept
+{
+  std::free(pointer);
+}
+
+class HeapAllocation : public testing::Test
+{
+protected:
+
+  HeapAllocation() :
+    private_nh_("~")
+  {
+  }
+
+  // Tracker of previous test left its parameters on the server
+  virtual void SetUp()
+  {
+    for(size_t i = 0; i < sizeof(SCENARIO_PARAMS) / sizeof(SCENARIO_PARAMS[0]); i++)
+      private_nh_.deleteParam(SCENARIO_PARAMS[i]);
+    private_nh_.setParam("pipeline_drop_policy", std::string("block"));
+  }
+
+  ros::NodeHandle private_nh_;
+};
+
+TEST_F(HeapAllocation, SerialFrames)
+{
+  EXPECT_EQ(0u, countSteadyStateAllocations(false));
+}
+
+TEST_F(HeapAllocation, PipelineFrames)
+{
+  private_nh_.setParam("pipeline_enabled", true);
+  EXPECT_EQ(0u, countSteadyStateAllocations(false));
+}
+
+TEST_F(HeapAllocation, OpticalFlowFrames)
+{
+  private_nh_.setParam("detection_period", 3);
+  EXPECT_EQ(0u, countSteadyStateAllocations(false));
+}
+
+TEST_F(HeapAllocation, DebugImageFrames)
+{
+  EXPECT_EQ(0u, countSteadyStateAllocations(true));
+}
+
+TEST_F(HeapAllocation, DynamicRoiFrames)
+{
+  private_nh_.setParam("dynamic_roi", true);
+  EXPECT_EQ(0u, countSteadyStateAllocations(false));
+}
+
+TEST_F(HeapAllocation, DetectionTilesFrames)
+{
+  private_nh_.setParam("detection_tiles_x", 2);
+  private_nh_.setParam("detection_tiles_y", 2);
+  EXPECT_EQ(0u, countSteadyStateAllocations(false));
+}
+
+TEST_F(HeapAllocation, FastFrontEndFrames)
+{
+  private_nh_.setParam("fast_front_end", true);
+  EXPECT_EQ(0u, countSteadyStateAllocations(false));
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "heap_allocation_test");
+
+  // First backtrace loads the unwinder, which allocates
+  void *frames[1];
+  backtrace(frames, 1);
+
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+  return RUN_ALL_TESTS();
+}
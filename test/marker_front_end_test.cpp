@@ -0,0 +1,159 @@
+/*********************************************************************************************//**
+* @file marker_front_end_test.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <marker_front_end.h>
+#include <synthetic_scene.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+/** \brief Front end must find the same markers with the same corners as aruco::MarkerDetector.
+ *         Fixed 720p images of the synthetic scene, reproducible by its seed. Time of both is printed,
+ *         not checked, so that a slow machine does not fail the test */
+
+namespace
+{
+
+const int NUM_OF_FRAMES = 20;
+const double MAX_CORNER_DIFFERENCE = 1e-3;
+
+/** \brief Calibration of data/cal.ini */
+void
+calibration(cv::Mat &camera_matrix, cv::Mat &distortion, cv::Size &image_size)
+{
+  camera_matrix = (cv::Mat_<double>(3, 3) << 935.42960, 0, 585.35373, 0, 937.08261, 329.99629, 0, 0, 1);
+  distortion = (cv::Mat_<double>(1, 5) << 0.01702, -0.07796, -0.00345, -0.01646, 0);
+  image_size = cv::Size(1280, 720);
+}
+
+void
+renderFrames(const aruco_tracking::SyntheticScene::Options &options, std::vector<cv::Mat> &images)
+{
+  cv::Mat camera_matrix, distortion;
+  cv::Size image_size;
+  calibration(camera_matrix, distortion, image_size);
+
+  aruco_tracking::SyntheticScene scene(camera_matrix, distortion, image_size, options);
+  cv::Mat image;
+  tf::Transform truth;
+  for(int i = 0; i < NUM_OF_FRAMES; i++)
+  {
+    scene.render(i, NUM_OF_FRAMES, image, truth);
+    images.push_back(image.clone());
+  }
+}
+
+bool
+lessById(const aruco::Marker &a, const aruco::Marker &b)
+{
+  return a.id < b.id;
+}
+
+/** \brief Compares both front ends on every image and prints their mean times */
+void
+compareFrontEnds(const std::vector<cv::Mat> &images)
+{
+  aruco::MarkerDetector detector;
+  detector.setCornerRefinementMethod(aruco::MarkerDetector::SUBPIX);
+
+  aruco_tracking::MarkerFrontEnd front_end;
+  EXPECT_TRUE(front_end.configure(detector));
+
+  std::vector<aruco::Marker> expected, markers;
+  double detector_seconds = 0, front_end_seconds = 0;
+  for(size_t i = 0; i < images.size(); i++)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    detector.detect(images[i], expected);
+    detector_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    front_end.detect(images[i], markers);
+    front_end_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(expected.begin(), expected.end(), lessById);
+    std::sort(markers.begin(), markers.end(), lessById);
+
+    EXPECT_FALSE(expected.empty()) << "Frame " << i;
+    ASSERT_EQ(expected.size(), markers.size()) << "Frame " << i;
+    for(size_t j = 0; j < markers.size(); j++)
+    {
+      EXPECT_EQ(expected[j].id, markers[j].id) << "Frame " << i;
+      for(int c = 0; c < 4; c++)
+      {
+        EXPECT_NEAR(expected[j][c].x, markers[j][c].x, MAX_CORNER_DIFFERENCE) << "Frame " << i << " marker " << j;
+        EXPECT_NEAR(expected[j][c].y, markers[j][c].y, MAX_CORNER_DIFFERENCE) << "Frame " << i << " marker " << j;
+      }
+    }
+  }
+
+  std::cout << "720p detector " << 1000 * detector_seconds / images.size() << " ms, front end "
+            << 1000 * front_end_seconds / images.size() << " ms, speedup "
+            << detector_seconds / front_end_seconds << std::endl;
+  testing::Test::RecordProperty("speedup_percent", int(100 * detector_seconds / front_end_seconds));
+}
+
+}  // namespace
+
+TEST(MarkerFrontEnd, SameMarkersAsDetector)
+{
+  std::vector<cv::Mat> images;
+  renderFrames(aruco_tracking::SyntheticScene::Options(), images);
+  compareFrontEnds(images);
+}
+
+TEST(MarkerFrontEnd, SameMarkersAsDetectorBlurred)
+{
+  aruco_tracking::SyntheticScene::Options options;
+  options.blur_sigma = 1.5;
+  options.noise_sigma = 4.0;
+  std::vector<cv::Mat> images;
+  renderFrames(options, images);
+  compareFrontEnds(images);
+}
+
+TEST(MarkerFrontEnd, SameMarkersAsDetectorSmallMarkers)
+{
+  aruco_tracking::SyntheticScene::Options options;
+  options.distance_scale = 1.6;
+  std::vector<cv::Mat> images;
+  renderFrames(options, images);
+  compareFrontEnds(images);
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
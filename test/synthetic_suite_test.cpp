@@ -0,0 +1,248 @@
+/*********************************************************************************************//**
+* @file synthetic_suite_test.cpp
+*
+* Copyright (c)
+* Smart Robotic Systems
+* March 2015
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* Redistributions of source code must retain the above copyright notice, this
+* list of conditions and the following disclaimer.
+*
+* Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimer in the documentation
+* and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#include <camera_calibration_parsers/parse_ini.h>
+#include <aruco_tracking.h>
+#include <synthetic_scene.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+/** \brief Accuracy of every speed option on a synthetic scene with known ground truth, the modes of
+ *         scripts/synthetic_suite.sh. Every frame must have a pose within error limits */
+
+namespace
+{
+
+const int NUM_OF_FRAMES = 150;
+const double MAX_TRANSLATION_ERROR = 0.02;
+const double MAX_ROTATION_ERROR = 2.0;
+const int FRAME_TIMEOUT = 30;
+
+/** \brief Parameters changed by some mode, removed before every mode so the tracker's defaults apply */
+const char *MODE_PARAMS[] = {"roi_allowed", "roi_x", "roi_y", "roi_w", "roi_h", "pyramid_level",
+                             "detection_tiles_x", "detection_tiles_y", "dynamic_roi", "detection_period",
+                             "joint_pnp", "fast_front_end", "fast_front_end_verify", "frame_budget_ms"};
+
+std::mutex errors_mutex;
+std::vector<tf::Transform> ground_truth;
+std::atomic<size_t> frames_done(0);
+size_t frames_without_pose = 0;
+double max_translation_error = 0;
+double max_rotation_error = 0;
+
+void
+frameTimingCallback(int camera_index, const std_msgs::Header &header,
+                    const aruco_tracking::ArucoTracking::FrameTiming &timing,
+                    const aruco_tracking::ArucoMarkerConstPtr &marker_msg)
+{
+  std::lock_guard<std::mutex> lock(errors_mutex);
+  if(marker_msg && marker_msg->marker_visibile)
+  {
+    // Frame index is sequence number of synthetic image
+    tf::Transform estimate;
+    tf::poseMsgToTF(marker_msg->global_camera_pose, estimate);
+    const tf::Transform &truth = ground_truth[header.seq];
+    max_translation_error = std::max(max_translation_error, double((estimate.getOrigin() - truth.getOrigin()).length()));
+    max_rotation_error = std::max(max_rotation_error,
+                                  estimate.getRotation().angleShortestPath(truth.getRotation()) * 180 / M_PI);
+  }
+  else
+    frames_without_pose++;
+  frames_done++;
+}
+
+/** \brief Sequence rendered once and shared by all modes */
+const std::vector<sensor_msgs::ImageConstPtr> &
+syntheticImages()
+{
+  static std::vector<sensor_msgs::ImageConstPtr> images;
+  if(!images.empty())
+    return images;
+
+  ros::NodeHandle private_nh("~");
+  std::string calib_filename;
+  aruco_tracking::SyntheticScene::Options options;
+  private_nh.getParam("calibration_file", calib_filename);
+  private_nh.getParam("marker_size", options.marker_size);
+
+  sensor_msgs::CameraInfo camera_info;
+  std::string camera_name;
+  if(!camera_calibration_parsers::readCalibrationIni(calib_filename, camera_name, camera_info))
+    return images;
+
+  cv::Mat camera_matrix(3, 3, CV_64F), distortion = cv::Mat::zeros(1, 5, CV_64F);
+  for(int i = 0; i < 9; i++)
+    camera_matrix.at<double>(i / 3, i % 3) = camera_info.K[i];
+  for(size_t i = 0; i < std::min(camera_info.D.size(), size_t(5)); i++)
+    distortion.at<double>(0, i) = camera_info.D[i];
+
+  aruco_tracking::SyntheticScene scene(camera_matrix, distortion, cv::Size(camera_info.width, camera_info.height), options);
+
+  std_msgs::Header header;
+  header.frame_id = "camera";
+  cv::Mat image;
+  for(int i = 0; i < NUM_OF_FRAMES; i++)
+  {
+    tf::Transform truth;
+    scene.render(i, NUM_OF_FRAMES, image, truth);
+    ground_truth.push_back(truth);
+
+    header.seq = i;
+    images.push_back(cv_bridge::CvImage(header, sensor_msgs::image_encodings::MONO8, image.clone()).toImageMsg());
+  }
+  return images;
+}
+
+class SyntheticSuite : public testing::Test
+{
+protected:
+
+  SyntheticSuite() :
+    private_nh_("~")
+  {
+  }
+
+  virtual void SetUp()
+  {
+    for(size_t i = 0; i < sizeof(MODE_PARAMS) / sizeof(MODE_PARAMS[0]); i++)
+      private_nh_.deleteParam(MODE_PARAMS[i]);
+  }
+
+  /** \brief Replays the sequence through a tracker with parameters of the mode */
+  void expectAccurate()
+  {
+    const std::vector<sensor_msgs::ImageConstPtr> &images = syntheticImages();
+    ASSERT_EQ(size_t(NUM_OF_FRAMES), images.size()) << "Calibration not readable";
+
+    frames_done = 0;
+    frames_without_pose = 0;
+    max_translation_error = 0;
+    max_rotation_error = 0;
+
+    aruco_tracking::ArucoTracking tracker(&nh_, &private_nh_);
+    tracker.setFrameTimingCallback(&frameTimingCallback);
+    for(size_t i = 0; i < images.size(); i++)
+      tracker.imageCallback(images[i], 0);
+
+    // Pipeline mode finishes frames in its own threads
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while((frames_done < images.size()) &&
+          (std::chrono::steady_clock::now() - start < std::chrono::seconds(FRAME_TIMEOUT)))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::lock_guard<std::mutex> lock(errors_mutex);
+    EXPECT_EQ(images.size(), frames_done);
+    EXPECT_EQ(0u, frames_without_pose);
+    EXPECT_LE(max_translation_error, MAX_TRANSLATION_ERROR);
+    EXPECT_LE(max_rotation_error, MAX_ROTATION_ERROR);
+  }
+
+  ros::NodeHandle nh_;
+  ros::NodeHandle private_nh_;
+};
+
+}  // namespace
+
+TEST_F(SyntheticSuite, Default)
+{
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, Roi)
+{
+  private_nh_.setParam("roi_allowed", true);
+  private_nh_.setParam("roi_x", 320);
+  private_nh_.setParam("roi_y", 120);
+  private_nh_.setParam("roi_w", 640);
+  private_nh_.setParam("roi_h", 480);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, PyramidLevel)
+{
+  private_nh_.setParam("pyramid_level", 1);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, DetectionTiles)
+{
+  private_nh_.setParam("detection_tiles_x", 2);
+  private_nh_.setParam("detection_tiles_y", 2);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, DynamicRoi)
+{
+  private_nh_.setParam("dynamic_roi", true);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, DetectionPeriod)
+{
+  private_nh_.setParam("detection_period", 3);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, JointPnpOff)
+{
+  private_nh_.setParam("joint_pnp", false);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, FastFrontEnd)
+{
+  private_nh_.setParam("fast_front_end", true);
+  private_nh_.setParam("fast_front_end_verify", true);
+  expectAccurate();
+}
+
+TEST_F(SyntheticSuite, FrameBudget)
+{
+  private_nh_.setParam("frame_budget_ms", 5.0);
+  private_nh_.setParam("dynamic_roi", true);
+  expectAccurate();
+}
+
+int
+main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "synthetic_suite_test");
+  return RUN_ALL_TESTS();
+}